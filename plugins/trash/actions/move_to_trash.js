@@ -1,7 +1,10 @@
-if (system.os == "osx") {
-	system.exec("osascript", ["-l", "AppleScript", "-e", "tell application \"Finder\" to move POSIX file \"" + input.filePath + "\" to trash"]);
-} else if (system.os == "windows") {
-	// TODO
-} else if (system.os == "linux") {
-	system.exec("trash", [input.filePath]);
+for (var i = 0; i < input.filePaths.length; i++) {
+	var filePath = input.filePaths[i];
+	if (system.os == "osx") {
+		system.exec("osascript", ["-l", "AppleScript", "-e", "tell application \"Finder\" to move POSIX file \"" + filePath + "\" to trash"]);
+	} else if (system.os == "windows") {
+		// TODO
+	} else if (system.os == "linux") {
+		system.exec("trash", [filePath]);
+	}
 }
\ No newline at end of file
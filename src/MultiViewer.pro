@@ -21,26 +21,44 @@ HEADERS += \
 	action.h \
 	actionlistitemwidget.h \
 	actionthread.h \
+	animationplayer.h \
 	application.h \
+	batchscheduler.h \
 	consolewidget.h \
 	constants.h \
+	directorymodel.h \
+	directoryscanner.h \
+	duplicatefinder.h \
+	displayrendertask.h \
 	exif.h \
+	filesignature.h \
 	iapplication.h \
+	imagecache.h \
+	imageloader.h \
 	messageboxes.h \
+	metadataindex.h \
+	mipmaptask.h \
 	mvplugininterface.h \
 	packagemanager.h \
 	paths.h \
+	performancelog.h \
 	plugin.h \
 	pluginevents.h \
 	pluginmanager.h \
+	prefetchscheduler.h \
 	preferencesdialog.h \
 	processutil.h \
+	resampler.h \
 	scriptutil.h \
 	settings.h \
 	simplefunctions.h \
 	simpletypes.h \
 	stringutil.h \
+	thumbnailcache.h \
+	tiffreader.h \
+	tiledimageitem.h \
 	version.h \
+	ziparchive.h \
     mainwindow.h \
     progressbardialog.h \
     jsapi/jsapi_application.h \
@@ -57,20 +75,38 @@ SOURCES += main.cpp \
 	action.cpp \
 	actionlistitemwidget.cpp \
 	actionthread.cpp \
+	animationplayer.cpp \
 	application.cpp \
+	batchscheduler.cpp \
 	consolewidget.cpp \
+	directorymodel.cpp \
+	directoryscanner.cpp \
+	duplicatefinder.cpp \
+	displayrendertask.cpp \
 	exif.cpp \
+	filesignature.cpp \
+	imagecache.cpp \
+	imageloader.cpp \
 	messageboxes.cpp \
+	metadataindex.cpp \
+	mipmaptask.cpp \
 	packagemanager.cpp \
 	paths.cpp \
+	performancelog.cpp \
 	plugin.cpp \
 	pluginmanager.cpp \
+	prefetchscheduler.cpp \
 	preferencesdialog.cpp \
 	processutil.cpp \
+	resampler.cpp \
 	settings.cpp \
 	scriptutil.cpp \
 	stringutil.cpp \
+	thumbnailcache.cpp \
+	tiffreader.cpp \
+	tiledimageitem.cpp \
 	version.cpp \
+	ziparchive.cpp \
     mainwindow.cpp \
     progressbardialog.cpp \
     jsapi/jsapi_application.cpp \
@@ -88,11 +124,17 @@ RESOURCES += resources.qrc
 macx {
 	INCLUDEPATH += "/usr/local/Cellar/freeimage/3.15.4/include"
 	LIBS += /usr/local/Cellar/freeimage/3.15.4/lib/libfreeimage.dylib
+	# libtiff from Homebrew
+	INCLUDEPATH += /usr/local/include
+	LIBS += -L/usr/local/lib
 }
 
 unix {
 	INCLUDEPATH += /usr/include
 	LIBS += /usr/lib/libfreeimage.so
+	# Also used on OS X, which is unix too
+	LIBS += -lz
+	LIBS += -ltiff
 }
 
 FORMS += \
@@ -0,0 +1,181 @@
+#include "animationplayer.h"
+
+namespace mv {
+
+AnimationDecoder::AnimationDecoder(QObject* receiver, const QString& filePath) {
+	receiver_ = receiver;
+	filePath_ = filePath;
+	maxFrames_ = AnimationPlayer::MinBufferedFrames;
+	stopped_ = false;
+	done_ = false;
+}
+
+void AnimationDecoder::run() {
+	bool firstLoop = true;
+
+	while (true) {
+		// The reader is recreated for each loop since QImageReader can't
+		// rewind to the first frame.
+		QImageReader reader(filePath_);
+		int frameCount = 0;
+
+		while (reader.canRead()) {
+			AnimationFrame frame;
+			frame.image = reader.read();
+			if (frame.image.isNull()) break;
+
+			// Browsers use 100ms for frames with no or a very short delay,
+			// and some GIFs rely on it.
+			frame.delay = reader.nextImageDelay();
+			if (frame.delay <= 10) frame.delay = 100;
+
+			if (firstLoop && frameCount == 0) {
+				qint64 frameBytes = qMax((qint64)1, (qint64)frame.image.byteCount());
+				QMutexLocker locker(&mutex_);
+				maxFrames_ = qBound((qint64)AnimationPlayer::MinBufferedFrames, AnimationPlayer::MaxBufferBytes / frameBytes, (qint64)AnimationPlayer::MaxBufferedFrames);
+			}
+
+			frameCount++;
+			if (!enqueueFrame(frame)) return;
+		}
+
+		firstLoop = false;
+
+		// Nothing to loop over if the image is not actually animated or if
+		// it can't be decoded.
+		if (frameCount <= 1) break;
+	}
+
+	QMutexLocker locker(&mutex_);
+	done_ = true;
+	locker.unlock();
+	QMetaObject::invokeMethod(receiver_, "decoder_frameDecoded", Qt::QueuedConnection);
+}
+
+// Blocks while the queue is full. Returns false if the decoder has been
+// stopped in the meantime.
+bool AnimationDecoder::enqueueFrame(const AnimationFrame& frame) {
+	QMutexLocker locker(&mutex_);
+	while (!stopped_ && frames_.size() >= maxFrames_) notFull_.wait(&mutex_);
+	if (stopped_) return false;
+	frames_.enqueue(frame);
+	locker.unlock();
+
+	QMetaObject::invokeMethod(receiver_, "decoder_frameDecoded", Qt::QueuedConnection);
+	return true;
+}
+
+void AnimationDecoder::stop() {
+	QMutexLocker locker(&mutex_);
+	stopped_ = true;
+	notFull_.wakeAll();
+}
+
+bool AnimationDecoder::takeFrame(AnimationFrame* frame) {
+	QMutexLocker locker(&mutex_);
+	if (frames_.isEmpty()) return false;
+	*frame = frames_.dequeue();
+	notFull_.wakeAll();
+	return true;
+}
+
+// True once all the frames have been decoded, which only happens for images
+// that have a single frame.
+bool AnimationDecoder::isDone() {
+	QMutexLocker locker(&mutex_);
+	return done_ && frames_.isEmpty();
+}
+
+AnimationPlayer::AnimationPlayer(QObject* parent) : QObject(parent) {
+	decoder_ = NULL;
+	waitingForFrame_ = false;
+
+	frameTimer_ = new QTimer(this);
+	frameTimer_->setSingleShot(true);
+	connect(frameTimer_, SIGNAL(timeout()), this, SLOT(frameTimer_timeout()));
+}
+
+// Decoders post their frames to the player, so they must not outlive it
+AnimationPlayer::~AnimationPlayer() {
+	stop();
+	for (int i = 0; i < stoppingDecoders_.size(); i++) {
+		stoppingDecoders_[i]->wait();
+		delete stoppingDecoders_[i];
+	}
+}
+
+void AnimationPlayer::start(const QString& filePath) {
+	stop();
+	if (filePath == "") return;
+
+	source_ = filePath;
+	waitingForFrame_ = true;
+	decoder_ = new AnimationDecoder(this, filePath);
+	connect(decoder_, SIGNAL(finished()), this, SLOT(decoder_finished()));
+	decoder_->start(QThread::LowPriority);
+}
+
+// The decoder might be in the middle of a frame, so it is not waited for.
+// It is deleted once its thread has finished.
+void AnimationPlayer::stop() {
+	frameTimer_->stop();
+	waitingForFrame_ = false;
+	source_ = "";
+
+	if (!decoder_) return;
+	decoder_->stop();
+	if (decoder_->isFinished()) {
+		decoder_->deleteLater();
+	} else {
+		stoppingDecoders_.append(decoder_);
+	}
+	decoder_ = NULL;
+}
+
+QString AnimationPlayer::source() const {
+	return source_;
+}
+
+bool AnimationPlayer::isPlaying() const {
+	return decoder_ != NULL;
+}
+
+void AnimationPlayer::showNextFrame() {
+	if (!decoder_) return;
+
+	AnimationFrame frame;
+	if (!decoder_->takeFrame(&frame)) {
+		if (decoder_->isDone()) {
+			stop();
+		} else {
+			// The decoder is behind, so the frame is displayed as soon as
+			// it's available.
+			waitingForFrame_ = true;
+		}
+		return;
+	}
+
+	waitingForFrame_ = false;
+	emit frameChanged(source_, frame.image);
+	frameTimer_->start(frame.delay);
+}
+
+void AnimationPlayer::frameTimer_timeout() {
+	showNextFrame();
+}
+
+// Queued calls from a decoder that has since been stopped are harmless
+// since they only trigger a check of the current decoder's queue.
+void AnimationPlayer::decoder_frameDecoded() {
+	if (waitingForFrame_) showNextFrame();
+}
+
+// Decoders that finish on their own (eg. for single frame images) are still
+// current and are deleted by stop() instead.
+void AnimationPlayer::decoder_finished() {
+	AnimationDecoder* decoder = dynamic_cast<AnimationDecoder*>(sender());
+	if (!decoder || !stoppingDecoders_.removeOne(decoder)) return;
+	decoder->deleteLater();
+}
+
+}
@@ -0,0 +1,89 @@
+#ifndef MV_ANIMATIONPLAYER_H
+#define MV_ANIMATIONPLAYER_H
+
+namespace mv {
+
+struct AnimationFrame {
+	QImage image;
+	int delay;
+};
+
+// Decodes the frames of an animation, in a loop, on its own thread. Decoded
+// frames are kept in a bounded queue and the thread blocks when it is full,
+// so it stays only a few frames ahead of the one being displayed.
+class AnimationDecoder : public QThread {
+
+	Q_OBJECT
+
+public:
+
+	AnimationDecoder(QObject* receiver, const QString& filePath);
+	void run();
+	void stop();
+	bool takeFrame(AnimationFrame* frame);
+	bool isDone();
+
+private:
+
+	bool enqueueFrame(const AnimationFrame& frame);
+
+	QObject* receiver_;
+	QString filePath_;
+	QMutex mutex_;
+	QWaitCondition notFull_;
+	QQueue<AnimationFrame> frames_;
+	int maxFrames_;
+	bool stopped_;
+	bool done_;
+
+};
+
+// Plays animated images (eg. GIF) without ever holding all their frames in
+// memory. Frames are decoded by an AnimationDecoder and displayed, through
+// the frameChanged() signal, at the pace set by the frame delays. Images
+// that turn out to have a single frame simply stop the player after that
+// frame.
+class AnimationPlayer : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	// Decoded frames that are waiting to be displayed use at most this much
+	// memory, but there are always at least MinBufferedFrames of them.
+	static const int MaxBufferBytes = 64 * 1024 * 1024;
+	static const int MinBufferedFrames = 2;
+	static const int MaxBufferedFrames = 16;
+
+	AnimationPlayer(QObject* parent = 0);
+	~AnimationPlayer();
+	void start(const QString& filePath);
+	void stop();
+	QString source() const;
+	bool isPlaying() const;
+
+private:
+
+	void showNextFrame();
+
+	AnimationDecoder* decoder_;
+	QList<AnimationDecoder*> stoppingDecoders_;
+	QTimer* frameTimer_;
+	QString source_;
+	bool waitingForFrame_;
+
+public slots:
+
+	void frameTimer_timeout();
+	void decoder_frameDecoded();
+	void decoder_finished();
+
+signals:
+
+	void frameChanged(const QString& filePath, const QImage& image);
+
+};
+
+}
+
+#endif // MV_ANIMATIONPLAYER_H
@@ -3,16 +3,25 @@
 #include "constants.h"
 #include "exif.h"
 #include "paths.h"
+#include "performancelog.h"
 #include "settings.h"
 #include "simplefunctions.h"
 #include "stringutil.h"
 #include "version.h"
+#include "ziparchive.h"
 
 namespace mv {
 
 QStringList queuedMessages_;
 QMutex myMessageHandlerMutex_;
 
+// Indexed by DirectoryModel::SortMode
+QStringList sortActionIds() {
+	QStringList output;
+	output << "sort_by_name" << "sort_by_capture_time" << "sort_by_modification_time" << "sort_by_size";
+	return output;
+}
+
 void myMessageHandler(QtMsgType type, const QMessageLogContext&, const QString& msg) {
 	QMutexLocker locker(&myMessageHandlerMutex_);
 
@@ -49,7 +58,24 @@ Application::Application(int &argc, char **argv, int applicationFlags) : QApplic
 	preferencesDialog_ = NULL;
 	menuBar_ = NULL;
 	preloadTimer_ = NULL;
+	reloadTimer_ = NULL;
+	skimTimer_ = NULL;
+	perfStatusTimer_ = NULL;
+	loggedImageCount_ = 0;
+	sourceInArchive_ = false;
 	browsingDirection_ = Forward;
+	fileChangeRequestId_ = 0;
+	fileChangeThreadPool_.setMaxThreadCount(1);
+	sourceIndex_ = -1;
+	openFirstSourcePending_ = false;
+
+	directoryModel_ = new DirectoryModel(this);
+	directoryModel_->setFileExtensions(supportedFileExtensions());
+	connect(directoryModel_, SIGNAL(changed()), this, SLOT(directoryModel_changed()));
+
+	duplicateFinder_ = new DuplicateFinder(this);
+	connect(duplicateFinder_, SIGNAL(progress(int, int)), this, SLOT(duplicateFinder_progress(int, int)));
+	connect(duplicateFinder_, SIGNAL(found(const mv::DuplicateGroups&)), this, SLOT(duplicateFinder_found(const mv::DuplicateGroups&)));
 
 	Application::setOrganizationName(VER_COMPANYNAME_STR);
 	Application::setOrganizationDomain(VER_DOMAIN_STR);
@@ -67,11 +93,35 @@ void Application::initialize() {
 
 	Settings settings;
 
+	prefetchScheduler_.setAhead(settings.value("prefetchAhead").toInt());
+	prefetchScheduler_.setBehind(settings.value("prefetchBehind").toInt());
+	prefetchScheduler_.setMaxAhead(settings.value("prefetchMaxAhead").toInt());
+	directoryModel_->setSortMode((DirectoryModel::SortMode)settings.value("sortMode").toInt());
+
 	preloadTimer_ = new QTimer(this);
 	preloadTimer_->setInterval(100);
 	preloadTimer_->setSingleShot(true);
 	connect(preloadTimer_, SIGNAL(timeout()), this, SLOT(preloadTimer_timeout()));
 
+	// Change notifications are coalesced since programs often write files
+	// in several steps, each of them triggering a notification.
+	reloadTimer_ = new QTimer(this);
+	reloadTimer_->setInterval(300);
+	reloadTimer_->setSingleShot(true);
+	connect(reloadTimer_, SIGNAL(timeout()), this, SLOT(reloadTimer_timeout()));
+
+	// Fires once navigation has settled after skimming through images
+	skimTimer_ = new QTimer(this);
+	skimTimer_->setInterval(PrefetchScheduler::SkimInterval);
+	skimTimer_->setSingleShot(true);
+	connect(skimTimer_, SIGNAL(timeout()), this, SLOT(skimTimer_timeout()));
+
+	// The performance status item is refreshed periodically rather than
+	// after each paint, since updating it triggers a paint.
+	perfStatusTimer_ = new QTimer(this);
+	perfStatusTimer_->setInterval(500);
+	connect(perfStatusTimer_, SIGNAL(timeout()), this, SLOT(perfStatusTimer_timeout()));
+
 	mainWindow_ = new MainWindow();
 
 	#ifdef Q_OS_MAC
@@ -88,6 +138,7 @@ void Application::initialize() {
 
 	connect(mainWindow_, SIGNAL(keypressed(QKeyEvent*)), this, SLOT(mainWindow_keypressed(QKeyEvent*)));
 	connect(mainWindow_, SIGNAL(closed()), this, SLOT(mainWindow_closed()));
+	connect(mainWindow_, SIGNAL(sourceLoaded()), this, SLOT(mainWindow_sourceLoaded()));
 	connect(&fsWatcher_, SIGNAL(fileChanged(const QString&)), this, SLOT(fsWatcher_fileChanged(const QString&)));
 
 	QStringList filePaths = args.positionalArguments();
@@ -98,6 +149,9 @@ void Application::initialize() {
 	mainWindow_->setStatusItem("dimensions", "");
 	mainWindow_->setStatusItem("counter", "");
 	mainWindow_->setStatusItem("zoom", "");
+	mainWindow_->setStatusItem("perf", "");
+	mainWindow_->setStatusItem("duplicates", "");
+	if (settings.value("showPerformanceStatus").toBool()) perfStatusTimer_->start();
 
 	refreshStatusBar();
 
@@ -124,36 +178,79 @@ void Application::initialize() {
 }
 
 void Application::preloadTimer_timeout() {
-	QString p = browsingDirection_ == Backward ? previousSourcePath() : nextSourcePath();
-	if (p == "") return;
-	mainWindow_->loadSource(p);
+	if (source_ == "") return;
+	// Prefetching resumes once skimming stops
+	if (skimTimer_->isActive()) return;
+
+	// Leave room in the cache for the current image
+	int maxImages = mainWindow_->imageCache()->estimatedCapacity();
+	if (maxImages > 0) maxImages--;
+
+	int direction = browsingDirection_ == Backward ? -1 : +1;
+	DirectoryModel* model = directoryModel(source_);
+	IntVector indexes = prefetchScheduler_.window(model->count(), sourceIndex(), direction, maxImages);
+	QStringList paths;
+	for (int i = 0; i < (int)indexes.size(); i++) paths << model->filePath(indexes[i]);
+	mainWindow_->prefetchSources(paths);
 }
 
 void Application::fsWatcher_fileChanged(const QString& path) {
-	if (path == source_) {
-		if (!QFileInfo::exists(path)) {
-			// File has been deleted
-			int sourceIndex = this->sourceIndex();
-			refreshSources();
-			QStringList sources = this->sources();
-			if (sources.size() == 0) {
-				setSource("");
-			} else {
-				if (sourceIndex < 0) {
-					// Shouldn't happen but sometime does. In that case, reset
-					// it to 0. Behavior won't be right but better than crashing.
-					qWarning() << "Application::fsWatcher_fileChanged: sourceIndex was" << sourceIndex;
-					sourceIndex = 0;
-				}
-				if (sourceIndex >= sources.size()) sourceIndex = 0;
-				setSource(sources[sourceIndex]);
-			}
+	if (path == source_) reloadTimer_->start();
+}
+
+void Application::reloadTimer_timeout() {
+	QString path = source_;
+	if (path == "") return;
+
+	if (!QFileInfo::exists(path)) {
+		// File has been deleted. The file that took its place in the list
+		// is displayed, even if the directory model has already removed it.
+		DirectoryModel* model = directoryModel(path);
+		int sourceIndex = model->nearestIndex(sourceFilePath_);
+		model->removeFile(sourceFilePath_);
+		if (model->count() == 0) {
+			setSource("");
 		} else {
-			reloadSource();
+			if (sourceIndex >= model->count()) sourceIndex = 0;
+			setSource(model->filePath(sourceIndex));
 		}
+	} else {
+		// Files that are replaced (rather than modified in place) are no
+		// longer watched.
+		if (!fsWatcher_.files().contains(path)) fsWatcher_.addPath(path);
+
+		// The file is compared on a worker thread with its signature from
+		// when the displayed image was decoded, so that touching it or
+		// rewriting the same content doesn't decode it again.
+		fileChangeRequestId_++;
+		fileChangeThreadPool_.start(new FileChangeTask(this, path, mainWindow_->sourceSignature(), fileChangeRequestId_));
 	}
 }
 
+void Application::fileChangeTask_done(const QString& filePath, bool changed, int requestId) {
+	if (requestId != fileChangeRequestId_ || filePath != source_) return;
+	if (changed) reloadSource();
+}
+
+void Application::perfStatusTimer_timeout() {
+	mainWindow_->setStatusItem("perf", performanceLog::imageSummary(source_));
+}
+
+// Logs the timings of the image, and every 20 images the percentiles of the
+// whole session.
+void Application::logPerformance(const QString& filePath) {
+	QString summary = performanceLog::imageSummary(filePath);
+	if (summary != "") qDebug() << qPrintable(QString("perf: %1: %2").arg(QFileInfo(filePath).fileName()).arg(summary));
+
+	loggedImageCount_++;
+	if (loggedImageCount_ % 20 == 0) qDebug() << qPrintable("perf: session: " + performanceLog::sessionSummary());
+}
+
+void Application::skimTimer_timeout() {
+	mainWindow_->setSkimming(false);
+	preloadTimer_timeout();
+}
+
 void Application::refreshMenu(const QString& actionId) {
 	if (actionId == "") {
 		ActionVector actions = this->actions();
@@ -165,10 +262,35 @@ void Application::refreshMenu(const QString& actionId) {
 	}
 
 	Action* action = actionById(actionId);
-	if (actionId == "undo") action->setEnabled(undoVector_.size() > 0);
+	if (actionId == "undo") {
+		action->setEnabled(undoVector_.size() > 0 && !sourceInArchive_);
+	} else if (modifiesFiles(actionId)) {
+		action->setEnabled(!sourceInArchive_);
+	}
+
+	int sortMode = sortActionIds().indexOf(actionId);
+	if (sortMode >= 0) {
+		action->setCheckable(true);
+		action->setChecked(directoryModel_->sortMode() == sortMode);
+	}
+}
+
+// Undo, batch operations and plugin actions, which run commands on the
+// files themselves (eg. to rotate them or move them to the trash), can't
+// act on archive entries.
+bool Application::modifiesFiles(const QString& actionId) const {
+	if (actionId == "undo" || actionId == "batch_duplicates") return true;
+
+	PluginVector plugins = pluginManager()->plugins();
+	for (unsigned int i = 0; i < plugins.size(); i++) {
+		if (plugins[i]->findAction(actionId)) return true;
+	}
+	return false;
 }
 
 void Application::pushUndoState() {
+	if (sourceInArchive_) return;
+
 	QFile file(source());
 
 	if (!file.open(QIODevice::ReadOnly)) {
@@ -189,7 +311,7 @@ void Application::popUndoState() {
 }
 
 void Application::undo() {
-	if (undoVector_.size() <= 0) return;
+	if (undoVector_.size() <= 0 || sourceInArchive_) return;
 
 	QFile file(source());
 	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
@@ -265,6 +387,11 @@ void Application::setupActions() {
 	createAction("toggle_console", tr("Toggle console"), "View", QKeySequence(Qt::Key_F12));
 	createAction("toggle_status_bar", tr("Toggle status bar"), "View");
 	createAction("toggle_toolbar", tr("Toggle tool bar"), "View");
+	createAction("toggle_performance_status", tr("Toggle performance info"), "View");
+	createAction("sort_by_name", tr("Sort by name"), "View");
+	createAction("sort_by_capture_time", tr("Sort by date taken"), "View");
+	createAction("sort_by_modification_time", tr("Sort by date modified"), "View");
+	createAction("sort_by_size", tr("Sort by size"), "View");
 
 	// ===============================================================================================
 	// OTHER
@@ -273,6 +400,10 @@ void Application::setupActions() {
 	createAction("close_console", tr("Close console"), "", QKeySequence(Qt::Key_Escape));
 	createAction("about", tr("About"), "Help");
 	createAction("preferences", tr("Preferences"), "Tools");
+	createAction("find_duplicates", tr("Find duplicates"), "Tools");
+	createAction("next_duplicate", tr("Next duplicate"), "Tools", QKeySequence("Ctrl+G"));
+	createAction("previous_duplicate", tr("Previous duplicate"), "Tools", QKeySequence("Ctrl+Shift+G"));
+	createAction("batch_duplicates", tr("Batch operation on duplicates..."), "Tools");
 
 	PluginVector plugins = pluginManager()->plugins();
 	for (unsigned int i = 0; i < plugins.size(); i++) {
@@ -478,9 +609,7 @@ bool Application::event(QEvent *event) {
 			browsingDirection_ = Forward;
 
 			if (QFileInfo(filePath).isDir()) {
-				QStringList sources = this->sources(filePath);
-				if (!sources.size()) return true;
-				setSource(sources[0]);
+				openFirstSource(filePath);
 			} else {
 				setSource(filePath);
 			}
@@ -506,9 +635,21 @@ QString Application::source() const {
 	return source_;
 }
 
+// Archives are opened like directories, from their first file
 void Application::setSource(const QString &source) {
+	if (ZipArchive::isArchive(source)) {
+		openFirstSource(source);
+		return;
+	}
+
 	if (source == source_) return;
+	QString previousSource = source_;
 	source_ = source;
+	openFirstSourcePending_ = false;
+	sourceFilePath_ = source == "" ? "" : QFileInfo(source).absoluteFilePath();
+	// The previous image is logged once it's no longer displayed, so that
+	// all its stages have been recorded.
+	if (perfStatusTimer_ && perfStatusTimer_->isActive() && previousSource != "") logPerformance(previousSource);
 	onSourceChange();
 }
 
@@ -526,6 +667,7 @@ void Application::execAction(const QString& actionName, const QStringList& fileP
 		QString filePath = QFileDialog::getOpenFileName(NULL, tr("Open File"), lastDir, supportedFilesFilter());
 		if (filePath != "") {
 			browsingDirection_ = Forward;
+			// Also opens archives
 			setSource(filePath);
 			settings.setValue("lastOpenFileDirectory", QVariant(QFileInfo(filePath).absolutePath()));
 		}
@@ -598,6 +740,31 @@ void Application::execAction(const QString& actionName, const QStringList& fileP
 		return;
 	}
 
+	// When shown, timings are also logged to the console for each image
+	if (actionName == "toggle_performance_status") {
+		bool show = !perfStatusTimer_->isActive();
+		if (show) {
+			perfStatusTimer_->start();
+			perfStatusTimer_timeout();
+		} else {
+			perfStatusTimer_->stop();
+			mainWindow_->setStatusItem("perf", "");
+			qDebug() << qPrintable("perf: session: " + performanceLog::sessionSummary());
+		}
+		Settings settings;
+		settings.setValue("showPerformanceStatus", show);
+		return;
+	}
+
+	int sortMode = sortActionIds().indexOf(actionName);
+	if (sortMode >= 0) {
+		directoryModel_->setSortMode((DirectoryModel::SortMode)sortMode);
+		Settings settings;
+		settings.setValue("sortMode", sortMode);
+		for (int i = 0; i < sortActionIds().size(); i++) refreshMenu(sortActionIds()[i]);
+		return;
+	}
+
 	if (actionName == "toggle_toolbar") {
 		mainWindow_->toggleToolbar();
 		Settings settings;
@@ -620,7 +787,39 @@ void Application::execAction(const QString& actionName, const QStringList& fileP
 		return;
 	}
 
-	pluginManager_->execAction(actionName, filePaths);
+	if (actionName == "find_duplicates") {
+		findDuplicates();
+		return;
+	}
+
+	if (actionName == "next_duplicate") {
+		showDuplicate(+1);
+		return;
+	}
+
+	if (actionName == "previous_duplicate") {
+		showDuplicate(-1);
+		return;
+	}
+
+	// Shortcuts and batch operations don't go through the menu, so the
+	// files are also checked here.
+	if (actionName == "batch_duplicates") {
+		if (!sourceInArchive_) batchDuplicates();
+		return;
+	}
+
+	QStringList editableFilePaths = filePaths;
+	if (modifiesFiles(actionName)) {
+		for (int i = editableFilePaths.size() - 1; i >= 0; i--) {
+			if (!ZipArchive::isArchiveEntry(editableFilePaths[i])) continue;
+			qWarning() << "Cannot run" << actionName << "on" << editableFilePaths[i] << "as it is in an archive";
+			editableFilePaths.removeAt(i);
+		}
+		if (filePaths.size() && !editableFilePaths.size()) return;
+	}
+
+	pluginManager_->execAction(actionName, editableFilePaths);
 }
 
 void Application::mainWindow_keypressed(QKeyEvent* event) {
@@ -633,6 +832,10 @@ void Application::mainWindow_closed() {
 	closeWindowCleanup();
 }
 
+void Application::mainWindow_sourceLoaded() {
+	refreshStatusBar();
+}
+
 void Application::mainWindow_actionTriggered() {
 	Action* action = dynamic_cast<Action*>(sender());
 	QString name = action->id();
@@ -645,31 +848,65 @@ void Application::onZoomChange() {
 
 void Application::onSourceChange() {
 	undoVector_.clear();
-	preloadTimer_->stop();
 
+	bool inArchive = source_ != "" && ZipArchive::isArchiveEntry(source_);
+	if (inArchive != sourceInArchive_) {
+		sourceInArchive_ = inArchive;
+		refreshMenu();
+	}
+
+	reloadTimer_->stop();
 	if (fsWatcher_.files().size()) fsWatcher_.removePaths(fsWatcher_.files());
-	if (source_ != "") fsWatcher_.addPath(source_);
+	// Files in archives are watched through the archive by the directory
+	// model
+	if (source_ != "" && !sourceInArchive_) fsWatcher_.addPath(source_);
 
 	if (mainWindow_->isHidden()) mainWindow_->show();
 	mainWindow_->resetZoom();
 	//Exif exif(source_);
 	// mainWindow_->setRotation(360 - exif.rotation());
+
+	if (prefetchScheduler_.isSkimming()) {
+		mainWindow_->setSkimming(true);
+		skimTimer_->start();
+	}
+
 	mainWindow_->setSource(source_);
 	setWindowTitle(QFileInfo(source_).fileName());
 	refreshStatusBar();
 
-	preloadTimer_->start();
+	// The timer is not restarted if it's already running, so that prefetching
+	// still happens when the user navigates faster than the timer interval
+	// (eg. by holding an arrow key).
+	if (!preloadTimer_->isActive()) preloadTimer_->start();
 }
 
 void Application::refreshStatusBar() {
 	int sourceIndex = this->sourceIndex();
-	QString counter = sourceIndex >= 0 ? QString("#%1/%2").arg(sourceIndex + 1).arg(sources().size()) : "#-/-";
+	QString counter;
+	if (directoryModel_->isLoading()) {
+		// The position of the file is not known until all the files have
+		// been listed
+		counter = QString("#?/%1").arg(QChar(0x2026));
+	} else {
+		counter = sourceIndex >= 0 ? QString("#%1/%2").arg(sourceIndex + 1).arg(directoryModel_->count()) : "#-/-";
+	}
 	mainWindow_->setStatusItem("counter", counter);
 
-	QPixmap* pixmap = mainWindow_->pixmap();
-	QString sizeString = pixmap ? QString("%1x%2").arg(pixmap->width()).arg(pixmap->height()) : "";
+	QSize sourceSize = mainWindow_->sourceSize();
+	QString sizeString = sourceSize.isValid() ? QString("%1x%2").arg(sourceSize.width()).arg(sourceSize.height()) : "";
 	mainWindow_->setStatusItem("dimensions", sizeString);
 
+	// Progress is shown instead while duplicates are being searched
+	if (!duplicateFinder_->isRunning()) {
+		QPair<int, int> position = duplicatePositions_.value(sourceFilePath_, qMakePair(-1, -1));
+		QString duplicates;
+		if (position.first >= 0) {
+			duplicates = tr("Duplicate %1/%2 of group %3/%4").arg(position.second + 1).arg(duplicateGroups_[position.first].size()).arg(position.first + 1).arg(duplicateGroups_.size());
+		}
+		mainWindow_->setStatusItem("duplicates", duplicates);
+	}
+
 	onZoomChange();
 }
 
@@ -725,6 +962,7 @@ QString Application::supportedFilesFilter() const {
 		if (filter != "") filter += " ";
 		filter += "*." + e;
 	}
+	filter += " *.zip *.cbz";
 	return tr("Supported Files (%1)").arg(filter);
 }
 
@@ -742,88 +980,76 @@ void Application::playLoopAnimation() {
 }
 
 void Application::setSourceIndex(int index) {
-	QStringList sources = this->sources();
-	if (!sources.size()) return;
+	DirectoryModel* model = directoryModel(source_);
+	if (index < 0 || index >= model->count()) return;
 
-	QString source = sources[index];
+	QString source = model->filePath(index);
 	sourceIndex_ = index;
 
 	setSource(source);
 }
 
 QString Application::nextSourcePath() const {
-	QStringList sources = this->sources();
-	if (!sources.size()) return "";
+	int count = directoryModel(source_)->count();
+	if (!count) return "";
 	int index = sourceIndex();
 	index++;
-	if (index >= sources.size()) index = 0;
-	return sources[index];
+	if (index >= count) index = 0;
+	return directoryModel_->filePath(index);
 }
 
 QString Application::previousSourcePath() const {
-	QStringList sources = this->sources();
-	if (!sources.size()) return "";
+	int count = directoryModel(source_)->count();
+	if (!count) return "";
 	int index = sourceIndex();
 	index--;
-	if (index < 0) index = sources.size() - 1;
-	return sources[index];
+	if (index < 0) index = count - 1;
+	return directoryModel_->filePath(index);
 }
 
 void Application::nextSource() {
 	int index = sourceIndex();
-	QStringList sources = this->sources();
 	index++;
-	if (index >= sources.size()) {
+	if (index >= directoryModel_->count()) {
 		index = 0;
 		playLoopAnimation();
 	}
 	browsingDirection_ = Forward;
+	prefetchScheduler_.onNavigate(+1);
 	setSourceIndex(index);
 }
 
 void Application::previousSource() {
 	int index = sourceIndex();
-	QStringList sources = this->sources();
 	index--;
 	if (index < 0) {
-		index = sources.size() - 1;
+		index = directoryModel_->count() - 1;
 		playLoopAnimation();
 	}
 	browsingDirection_ = Backward;
+	prefetchScheduler_.onNavigate(-1);
 	setSourceIndex(index);
 }
 
 int Application::sourceIndex() const {
-	QString source = this->source();
-
-	if (QFileInfo(source).dir().absolutePath() != sourceDir_) {
-		// Current dir has changed - reload source list
-		sourceIndex_ = -1;
-		sources_.clear();
-	}
-
-	QStringList sources = this->sources();
-	if (!sources.size()) return -1;
+	DirectoryModel* model = directoryModel(source_);
+	if (!model->count()) return -1;
 
-	source = QFileInfo(source).fileName();
+	// Check if the index we have is correct. It's usually still valid after
+	// the directory has changed, unless files were added or removed before
+	// the current one. Otherwise it's looked up again, which doesn't depend
+	// on the number of files either.
+	if (sourceIndex_ >= 0 && sourceIndex_ < model->count() && model->filePath(sourceIndex_) == sourceFilePath_) return sourceIndex_;
 
-	// Check if the index we have is correct
-	if (sourceIndex_ >= 0 && sourceIndex_ < sources.size() && sources[sourceIndex_] == source) return sourceIndex_;
-
-	// If it's not correct, try to get it from the current source and source list
-	sourceIndex_ = -1;
-
-	for (int i = 0; i < sources.size(); i++) {
-		if (QFileInfo(sources[i]).fileName() == source) {
-			sourceIndex_ = i;
-			break;
-		}
-	}
+	sourceIndex_ = model->indexOf(sourceFilePath_);
 	return sourceIndex_;
 }
 
+// The directory model keeps itself up to date, so this only looks for the
+// pending changes, if any, in the background. The model emits changed() if
+// there were some.
 void Application::refreshSources() {
-	sources_.clear();
+	directoryModel_->refresh();
 	sourceIndex_ = -1;
 }
 
@@ -866,29 +1092,148 @@ QStringList Application::sources() const {
 }
 
 QStringList Application::sources(const QString& filePath) const {
-	if (sources_.length()) return sources_;
+	return directoryModel(filePath)->filePaths();
+}
 
-	QStringList supportedFileExtensions = this->supportedFileExtensions();
-	sourceIndex_ = -1;
+// Returns the model for the directory of the given file (or for the given
+// directory), which is only listed if it's not the current one. Archives,
+// and files in archives, use the model of the archive. Most calls are for
+// the current source, whose directory is only resolved once.
+DirectoryModel* Application::directoryModel(const QString& filePath) const {
+	if (filePath == directoryModelFilePath_ && directoryModel_->directory() != "") return directoryModel_;
+	directoryModelFilePath_ = filePath;
 
 	QFileInfo fileInfo(filePath);
-	QDir dir;
-	if (fileInfo.isDir()) {
-		dir.setPath(filePath);
+	QString archivePath;
+	QString dirPath;
+	if (fileInfo.isDir() || ZipArchive::isArchive(filePath)) {
+		dirPath = fileInfo.absoluteFilePath();
+	} else if (ZipArchive::splitPath(filePath, &archivePath, NULL)) {
+		dirPath = archivePath;
 	} else {
-		dir = fileInfo.dir();
+		dirPath = fileInfo.absolutePath();
+	}
+
+	if (dirPath != directoryModel_->directory()) {
+		sourceIndex_ = -1;
+		directoryModel_->setDirectory(dirPath);
+		// The directory is listed in the background, so the file is added
+		// right away to be able to navigate from it. Archives are listed
+		// in one go from their central directory, so this isn't needed.
+		if (archivePath == "" && fileInfo.exists() && fileInfo.isFile()) directoryModel_->insertFile(fileInfo.absoluteFilePath());
+	}
+
+	return directoryModel_;
+}
+
+// Opens the first file of a directory or archive. It's only known once the
+// directory has been listed, in which case it's opened by
+// directoryModel_changed().
+void Application::openFirstSource(const QString& dirPath) {
+	DirectoryModel* model = directoryModel(dirPath);
+	if (model->isLoading()) {
+		openFirstSourcePending_ = true;
+		return;
+	}
+	if (!model->count()) return;
+	setSource(model->filePath(0));
+}
+
+void Application::directoryModel_changed() {
+	if (directoryModel_->isLoading()) {
+		if (mainWindow_) refreshStatusBar();
+		return;
+	}
+
+	if (openFirstSourcePending_) {
+		openFirstSourcePending_ = false;
+		if (directoryModel_->count()) setSource(directoryModel_->filePath(0));
+		return;
 	}
 
-	sourceDir_ = dir.absolutePath();
-	QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::LocaleAware);
-	for (int i = 0; i < files.size(); i++) {
-		if (!supportedFileExtensions.contains(files[i].suffix().toLower())) continue;
-		sources_.append(files[i].absoluteFilePath());
+	// Files added or removed in the current directory change the counter
+	// and the images that should be prefetched
+	if (mainWindow_) refreshStatusBar();
+	if (preloadTimer_ && source_ != "" && !preloadTimer_->isActive()) preloadTimer_->start();
+}
+
+
+// Searches the duplicates of the current directory (or archive), once it
+// has been fully listed.
+void Application::findDuplicates() {
+	if (source_ == "") return;
+
+	DirectoryModel* model = directoryModel(source_);
+	if (model->isLoading()) {
+		mainWindow_->setStatusItem("duplicates", tr("Directory is still being listed"));
+		return;
 	}
 
-	std::sort(sources_.begin(), sources_.end(), stringutil::NaturalSortCompare());
+	Settings settings;
+	mainWindow_->setStatusItem("duplicates", tr("Finding duplicates..."));
+	duplicateFinder_->find(model->directory(), model->fileNames(), settings.value("duplicateThreshold").toInt());
+}
 
-	return sources_;
+// Goes to the next (or previous) file of the duplicate groups, in the
+// following group once the current group is done. Files that no longer
+// exist, eg. those that have been moved to the trash, are skipped.
+void Application::showDuplicate(int direction) {
+	int count = duplicateFilePaths_.size();
+	if (!count) return;
+
+	int index = duplicateFilePaths_.indexOf(sourceFilePath_);
+	if (index < 0) index = direction > 0 ? -1 : count;
+
+	for (int i = 0; i < count; i++) {
+		index = (index + direction + count) % count;
+		QString filePath = duplicateFilePaths_[index];
+		if (!ZipArchive::isArchiveEntry(filePath) && !QFileInfo::exists(filePath)) continue;
+		browsingDirection_ = direction > 0 ? Forward : Backward;
+		setSource(filePath);
+		return;
+	}
+}
+
+// Passes the other files of the current group to the batch dialog, so that
+// the displayed one can be kept while the others are, eg., moved away.
+void Application::batchDuplicates() {
+	QPair<int, int> position = duplicatePositions_.value(sourceFilePath_, qMakePair(-1, -1));
+	if (position.first < 0) return;
+
+	QStringList filePaths = duplicateGroups_[position.first];
+	filePaths.removeAt(position.second);
+	for (int i = filePaths.size() - 1; i >= 0; i--) {
+		if (ZipArchive::isArchiveEntry(filePaths[i])) filePaths.removeAt(i);
+	}
+	if (!filePaths.size()) return;
+
+	BatchDialog dialog(mainWindow());
+	dialog.setModal(true);
+	dialog.setFilePaths(filePaths);
+	dialog.exec();
+}
+
+void Application::duplicateFinder_progress(int doneCount, int totalCount) {
+	mainWindow_->setStatusItem("duplicates", tr("Finding duplicates: %1/%2").arg(doneCount).arg(totalCount));
+}
+
+void Application::duplicateFinder_found(const mv::DuplicateGroups& groups) {
+	duplicateGroups_ = groups;
+	duplicateFilePaths_.clear();
+	duplicatePositions_.clear();
+	for (int i = 0; i < groups.size(); i++) {
+		for (int j = 0; j < groups[i].size(); j++) {
+			duplicateFilePaths_.append(groups[i][j]);
+			duplicatePositions_.insert(groups[i][j], qMakePair(i, j));
+		}
+	}
+
+	int fileCount = duplicateFilePaths_.size();
+	qDebug() << qPrintable(QString("Found %1 group(s) of duplicates (%2 files)").arg(groups.size()).arg(fileCount));
+
+	refreshStatusBar();
+	// Shown until the next image
+	if (!duplicatePositions_.contains(sourceFilePath_)) mainWindow_->setStatusItem("duplicates", groups.size() ? tr("%1 group(s) of duplicates").arg(groups.size()) : tr("No duplicates"));
 }
 
 }
@@ -4,9 +4,13 @@
 #include "iapplication.h" // remove
 
 #include "action.h"
+#include "directorymodel.h"
+#include "duplicatefinder.h"
+#include "filesignature.h"
 #include "mainwindow.h"
 #include "packagemanager.h"
 #include "pluginmanager.h"
+#include "prefetchscheduler.h"
 #include "preferencesdialog.h"
 #include "simpletypes.h"
 
@@ -53,22 +57,49 @@ private:
 	QString source_;
 	PluginManager* pluginManager_;
 	ActionVector builtinActions_;
-	mutable QStringList sources_;
+	DirectoryModel* directoryModel_;
+	mutable QString directoryModelFilePath_;
+	QString sourceFilePath_;
 	mutable int sourceIndex_;
-	mutable QString sourceDir_;
+	bool openFirstSourcePending_;
+	// Files in archives are read-only, so the actions that modify files are
+	// disabled for them
+	bool sourceInArchive_;
+	DuplicateFinder* duplicateFinder_;
+	DuplicateGroups duplicateGroups_;
+	// Files of all the groups one after the other, to navigate through them
+	QStringList duplicateFilePaths_;
+	// Group of each file and position in it
+	QHash<QString, QPair<int, int> > duplicatePositions_;
 	mutable Settings* settings_;
 	QStringQMenuMap menus_;
 	PreferencesDialog* preferencesDialog_;
 	QMenuBar* menuBar_;
 	QTimer* preloadTimer_;
+	QTimer* reloadTimer_;
+	QTimer* skimTimer_;
+	QTimer* perfStatusTimer_;
+	int loggedImageCount_;
+	// Checks whether the source has actually changed when it's reported as
+	// such
+	QThreadPool fileChangeThreadPool_;
+	int fileChangeRequestId_;
 	int browsingDirection_;
+	PrefetchScheduler prefetchScheduler_;
 	Action* createAction(const QString& name, const QString& text, const QString& menu, const QKeySequence& shortcut1 = QKeySequence(), const QKeySequence& shortcut2 = QKeySequence());
 	void registerAction(const QString& menuName, Action* action);
 	void playLoopAnimation();
+	void logPerformance(const QString& filePath);
+	DirectoryModel* directoryModel(const QString& filePath) const;
+	void openFirstSource(const QString& dirPath);
+	void findDuplicates();
+	void showDuplicate(int direction);
+	void batchDuplicates();
 	void saveWindowGeometry();
 	void loadWindowGeometry();
 	void setupActions();
 	void closeWindowCleanup();
+	bool modifiesFiles(const QString& actionId) const;
 	QFileSystemWatcher fsWatcher_;
 	mutable PackageManager* packageManager_;
 	QList<QByteArray> undoVector_;
@@ -78,8 +109,16 @@ public slots:
 	void mainWindow_keypressed(QKeyEvent* event);
 	void mainWindow_actionTriggered();
 	void mainWindow_closed();
+	void mainWindow_sourceLoaded();
 	void preloadTimer_timeout();
 	void fsWatcher_fileChanged(const QString& path);
+	void reloadTimer_timeout();
+	void fileChangeTask_done(const QString& filePath, bool changed, int requestId);
+	void skimTimer_timeout();
+	void perfStatusTimer_timeout();
+	void directoryModel_changed();
+	void duplicateFinder_progress(int doneCount, int totalCount);
+	void duplicateFinder_found(const mv::DuplicateGroups& groups);
 
 	QString source() const;
 	void setSource(const QString& source);
@@ -32,6 +32,14 @@ BatchDialog::~BatchDialog() {
 	delete ui;
 }
 
+// Files given this way replace the file dialog that's otherwise shown first
+void BatchDialog::setFilePaths(const QStringList& filePaths) {
+	firstShow_ = false;
+	ui->fileListWidget->clear();
+	ui->fileListWidget->addItems(filePaths);
+	updateButtons();
+}
+
 void BatchDialog::showEvent(QShowEvent* event) {
 	QDialog::showEvent(event);
 
@@ -72,7 +80,7 @@ void BatchDialog::addFilesButton_clicked() {
 
 	std::sort(files.begin(), files.end());
 	files.erase(std::unique(files.begin(), files.end()), files.end());
-	std::sort(files.begin(), files.end(), mv::stringutil::NaturalSortCompare());
+	mv::stringutil::naturalSort(files);
 
 	ui->fileListWidget->clear();
 	ui->fileListWidget->addItems(files);
@@ -14,6 +14,7 @@ public:
 
 	explicit BatchDialog(QWidget *parent = 0);
 	~BatchDialog();
+	void setFilePaths(const QStringList& filePaths);
 
 protected:
 
@@ -0,0 +1,166 @@
+#include "application.h"
+#include "batchscheduler.h"
+#include "pluginmanager.h"
+
+#include "jsapi/jsapi_application.h"
+#include "jsapi/jsapi_input.h"
+#include "jsapi/jsapi_plugin.h"
+#include "jsapi/jsapi_system.h"
+#include "jsapi/jsapi_ui.h"
+
+namespace mv {
+
+BatchWorkerThread::BatchWorkerThread(BatchScheduler* scheduler, QScriptEngine* engine, jsapi::System* system, const QString& scriptContent, const QString& scriptPath, const QRect& selectionRect, const QSize& imageSize) {
+	scheduler_ = scheduler;
+	engine_ = engine;
+	system_ = system;
+	scriptContent_ = scriptContent;
+	scriptPath_ = scriptPath;
+	selectionRect_ = selectionRect;
+	imageSize_ = imageSize;
+}
+
+void BatchWorkerThread::run() {
+	QString filePath;
+	while (scheduler_->takeFile(&filePath)) {
+		jsapi::Input* input = new jsapi::Input(engine_, QStringList() << filePath, selectionRect_, imageSize_);
+		engine_->globalObject().setProperty("input", engine_->newQObject(input));
+		system_->resetState();
+
+		engine_->evaluate(scriptContent_, scriptPath_);
+		// Errors only stop the current file
+		if (engine_->hasUncaughtException()) {
+			qWarning() << "Error while processing" << filePath;
+			PluginManager::logUncaughtException(engine_);
+		}
+
+		engine_->globalObject().setProperty("input", QScriptValue());
+		delete input;
+
+		QMetaObject::invokeMethod(scheduler_, "worker_fileDone", Qt::QueuedConnection);
+	}
+
+	engine_->collectGarbage();
+}
+
+BatchScheduler::BatchScheduler(QObject* parent) : QObject(parent) {
+	nextFileIndex_ = 0;
+	doneCount_ = 0;
+	runningThreadCount_ = 0;
+	allThreadsStarted_ = false;
+}
+
+BatchScheduler::~BatchScheduler() {
+	cancel();
+	for (int i = 0; i < (int)threads_.size(); i++) threads_[i]->wait();
+	clear();
+}
+
+// The engines are all set up at the start, but only the first one runs until
+// the first file has been processed.
+void BatchScheduler::start(Plugin* plugin, Action* action, const QString& scriptContent, const QString& scriptPath, const QStringList& filePaths) {
+	if (isRunning()) {
+		qWarning() << "A batch is already running";
+		return;
+	}
+
+	clear();
+
+	filePaths_ = filePaths;
+	nextFileIndex_ = 0;
+	doneCount_ = 0;
+	canceled_.store(0);
+	allThreadsStarted_ = false;
+
+	MainWindow* mainWindow = Application::instance()->mainWindow();
+	formAnswers_ = QSharedPointer<jsapi::FormAnswers>(new jsapi::FormAnswers());
+	int threadCount = qMax(1, qMin(QThread::idealThreadCount(), filePaths.size()));
+
+	for (int i = 0; i < threadCount; i++) {
+		QScriptEngine* engine = PluginManager::createScriptEngine();
+
+		QObject* jsPlugin = new jsapi::Plugin(engine, plugin, action);
+		jsPlugin->setParent(engine);
+		engine->globalObject().setProperty("plugin", engine->newQObject(jsPlugin));
+
+		qobject_cast<jsapi::Application*>(engine->globalObject().property("application").toQObject())->setUndoEnabled(false);
+		qobject_cast<jsapi::Ui*>(engine->globalObject().property("ui").toQObject())->setFormAnswers(formAnswers_);
+		jsapi::System* system = qobject_cast<jsapi::System*>(engine->globalObject().property("system").toQObject());
+
+		BatchWorkerThread* thread = new BatchWorkerThread(this, engine, system, scriptContent, scriptPath, mainWindow->selectionRect(), mainWindow->sourceSize());
+		connect(thread, SIGNAL(finished()), this, SLOT(workerThread_finished()));
+
+		engines_.push_back(engine);
+		systems_.push_back(system);
+		threads_.push_back(thread);
+	}
+
+	qDebug() << qPrintable(QString("Running %1 on %2 file(s) with %3 thread(s)").arg(scriptPath).arg(filePaths.size()).arg(threadCount));
+
+	emit progress(0, filePaths_.size());
+	startThread(0);
+}
+
+// Files that are being processed are aborted, and the remaining ones are
+// skipped. finished() is emitted once all the threads have stopped.
+void BatchScheduler::cancel() {
+	canceled_.store(1);
+	for (int i = 0; i < (int)engines_.size(); i++) {
+		systems_[i]->onScriptAbort();
+		engines_[i]->abortEvaluation();
+	}
+}
+
+bool BatchScheduler::isRunning() const {
+	return runningThreadCount_ > 0;
+}
+
+// Called by the worker threads. Returns false once there are no files left
+// or the batch has been canceled.
+bool BatchScheduler::takeFile(QString* filePath) {
+	if (canceled_.load()) return false;
+
+	QMutexLocker locker(&mutex_);
+	if (nextFileIndex_ >= filePaths_.size()) return false;
+	*filePath = filePaths_[nextFileIndex_];
+	nextFileIndex_++;
+	return true;
+}
+
+void BatchScheduler::startThread(int index) {
+	runningThreadCount_++;
+	threads_[index]->start();
+}
+
+void BatchScheduler::clear() {
+	for (int i = 0; i < (int)threads_.size(); i++) delete threads_[i];
+	// The jsapi objects are children of their engine
+	for (int i = 0; i < (int)engines_.size(); i++) delete engines_[i];
+	threads_.clear();
+	systems_.clear();
+	engines_.clear();
+}
+
+void BatchScheduler::worker_fileDone() {
+	doneCount_++;
+	emit progress(doneCount_, filePaths_.size());
+
+	if (allThreadsStarted_) return;
+	allThreadsStarted_ = true;
+
+	// The forms have been answered by now, if the script has any
+	if (formAnswers_->hasCanceledForm()) canceled_.store(1);
+	if (canceled_.load()) return;
+
+	for (int i = 1; i < (int)threads_.size(); i++) startThread(i);
+}
+
+void BatchScheduler::workerThread_finished() {
+	runningThreadCount_--;
+	if (runningThreadCount_ > 0) return;
+
+	qDebug() << qPrintable(QString("Processed %1/%2 file(s)").arg(doneCount_).arg(filePaths_.size()));
+	emit finished();
+}
+
+}
@@ -0,0 +1,93 @@
+#ifndef MV_BATCHSCHEDULER_H
+#define MV_BATCHSCHEDULER_H
+
+#include "action.h"
+#include "plugin.h"
+
+namespace jsapi {
+class FormAnswers;
+class System;
+}
+
+namespace mv {
+
+class BatchScheduler;
+
+// Runs the script of an action once per file, taking the files from the
+// scheduler until there are none left.
+class BatchWorkerThread : public QThread {
+
+	Q_OBJECT
+
+public:
+
+	BatchWorkerThread(BatchScheduler* scheduler, QScriptEngine* engine, jsapi::System* system, const QString& scriptContent, const QString& scriptPath, const QRect& selectionRect, const QSize& imageSize);
+	void run();
+
+private:
+
+	BatchScheduler* scheduler_;
+	QScriptEngine* engine_;
+	jsapi::System* system_;
+	QString scriptContent_;
+	QString scriptPath_;
+	QRect selectionRect_;
+	QSize imageSize_;
+
+};
+
+// Runs a batch action on a pool of independent script engines, one per
+// core, each on its own thread. The files are in a shared queue from which
+// each engine takes the next file once it's done with the previous one, so
+// that the engines stay busy until the end even if some files take longer.
+// Since each run of the script gets a single file, scripts that only handle
+// input.filePath also work in batch mode.
+//
+// The first file is processed alone, so that the forms of the script are
+// only shown once: the answers are then given to the other runs (see
+// jsapi::FormAnswers). If the form was canceled, the batch stops there.
+class BatchScheduler : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	BatchScheduler(QObject* parent = 0);
+	~BatchScheduler();
+	void start(Plugin* plugin, Action* action, const QString& scriptContent, const QString& scriptPath, const QStringList& filePaths);
+	void cancel();
+	bool isRunning() const;
+	bool takeFile(QString* filePath);
+
+private:
+
+	void startThread(int index);
+	void clear();
+
+	QStringList filePaths_;
+	int nextFileIndex_;
+	QMutex mutex_;
+	QAtomicInt canceled_;
+	int doneCount_;
+	int runningThreadCount_;
+	bool allThreadsStarted_;
+	QSharedPointer<jsapi::FormAnswers> formAnswers_;
+	std::vector<QScriptEngine*> engines_;
+	std::vector<jsapi::System*> systems_;
+	std::vector<BatchWorkerThread*> threads_;
+
+public slots:
+
+	void worker_fileDone();
+	void workerThread_finished();
+
+signals:
+
+	void progress(int doneCount, int totalCount);
+	void finished();
+
+};
+
+}
+
+#endif // MV_BATCHSCHEDULER_H
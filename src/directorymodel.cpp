@@ -0,0 +1,587 @@
+#include "directorymodel.h"
+#include "directoryscanner.h"
+#include "stringutil.h"
+#include "ziparchive.h"
+
+namespace mv {
+
+namespace {
+
+// Batches are posted when they reach this many files, or the number of files
+// posted so far if larger, so that merging them into the list doesn't
+// become quadratic. They are also posted at regular intervals when listing
+// is slow, so that the files show up progressively.
+const int MinBatchSize = 256;
+const int BatchInterval = 100;
+
+bool isSupportedFileName(const QString& fileName, const QSet<QString>& extensions) {
+	int dotIndex = fileName.lastIndexOf('.');
+	if (dotIndex < 0) return false;
+	return extensions.contains(fileName.mid(dotIndex + 1).toLower());
+}
+
+// Entries of an archive, including those in folders, are listed from its
+// central directory, which is read in one go.
+QStringList listArchiveFileNames(const QString& filePath, const QSet<QString>& extensions) {
+	QStringList output;
+
+	QString error;
+	QSharedPointer<ZipArchive> archive = ZipArchive::open(filePath, &error);
+	if (!archive) {
+		qWarning() << "Could not open archive" << filePath << ":" << error;
+		return output;
+	}
+
+	QStringList fileNames = archive->fileNames();
+	for (int i = 0; i < fileNames.size(); i++) {
+		if (isSupportedFileName(fileNames[i], extensions)) output.append(fileNames[i]);
+	}
+	return output;
+}
+
+QStringList listFileNames(const QString& dirPath, const QSet<QString>& extensions) {
+	if (ZipArchive::isArchive(dirPath)) return listArchiveFileNames(dirPath, extensions);
+
+	QStringList output;
+	DirectoryScanner scanner(dirPath, extensions);
+	QString fileName;
+	while (scanner.next(&fileName)) output.append(fileName);
+	return output;
+}
+
+QSet<QString> toSet(const QStringList& list) {
+	QSet<QString> output;
+	output.reserve(list.size());
+	for (int i = 0; i < list.size(); i++) output.insert(list[i]);
+	return output;
+}
+
+}
+
+DirectoryListTask::DirectoryListTask(DirectoryModel* model, const QString& dirPath, const QSet<QString>& extensions, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	model_ = model;
+	dirPath_ = dirPath;
+	extensions_ = extensions;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void DirectoryListTask::run() {
+	if (canceled_->load()) return;
+
+	if (ZipArchive::isArchive(dirPath_)) {
+		QStringList fileNames = listArchiveFileNames(dirPath_, extensions_);
+		QMetaObject::invokeMethod(model_, "listTask_fileNames", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(QStringList, fileNames), Q_ARG(bool, true));
+		return;
+	}
+
+	QStringList fileNames;
+	int batchSize = MinBatchSize;
+	int postedCount = 0;
+	QElapsedTimer timer;
+	timer.start();
+
+	DirectoryScanner scanner(dirPath_, extensions_);
+	QString fileName;
+	while (scanner.next(&fileName)) {
+		if (canceled_->load()) return;
+
+		fileNames.append(fileName);
+
+		if (fileNames.size() >= batchSize || timer.elapsed() >= BatchInterval) {
+			QMetaObject::invokeMethod(model_, "listTask_fileNames", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(QStringList, fileNames), Q_ARG(bool, false));
+			postedCount += fileNames.size();
+			batchSize = qMax(MinBatchSize, postedCount);
+			fileNames.clear();
+			timer.restart();
+		}
+	}
+
+	QMetaObject::invokeMethod(model_, "listTask_fileNames", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(QStringList, fileNames), Q_ARG(bool, true));
+}
+
+DirectoryRefreshTask::DirectoryRefreshTask(DirectoryModel* model, const QString& dirPath, const QSet<QString>& extensions, const QStringList& fileNames, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	model_ = model;
+	dirPath_ = dirPath;
+	extensions_ = extensions;
+	fileNames_ = fileNames;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+// The directory itself might have been deleted or renamed, in which case
+// nothing is listed.
+void DirectoryRefreshTask::run() {
+	if (canceled_->load()) return;
+
+	bool exists = QFileInfo::exists(dirPath_);
+	QStringList added;
+	QStringList removed;
+
+	if (exists) {
+		QStringList fileNames = listFileNames(dirPath_, extensions_);
+		if (canceled_->load()) return;
+
+		QSet<QString> fileNameSet = toSet(fileNames);
+		for (int i = 0; i < fileNames_.size(); i++) {
+			if (!fileNameSet.contains(fileNames_[i])) removed.append(fileNames_[i]);
+		}
+
+		QSet<QString> currentFileNameSet = toSet(fileNames_);
+		for (int i = 0; i < fileNames.size(); i++) {
+			if (!currentFileNameSet.contains(fileNames[i])) added.append(fileNames[i]);
+		}
+	}
+
+	if (canceled_->load()) return;
+
+	QMetaObject::invokeMethod(model_, "refreshTask_done", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(bool, exists), Q_ARG(QStringList, added), Q_ARG(QStringList, removed));
+}
+
+DirectoryModel::DirectoryModel(QObject* parent) : QObject(parent) {
+	archive_ = false;
+	listRequestId_ = 0;
+	loading_ = false;
+	refreshing_ = false;
+	refreshPending_ = false;
+	sortMode_ = SortByName;
+	activeSortMode_ = SortByName;
+	threadPool_.setMaxThreadCount(1);
+
+	metadataIndex_ = new MetadataIndex(this);
+	connect(metadataIndex_, SIGNAL(indexed()), this, SLOT(metadataIndex_indexed()));
+	connect(metadataIndex_, SIGNAL(updated()), this, SLOT(metadataIndex_updated()));
+
+	// Copying or deleting many files triggers a notification for each of
+	// them, so they are handled in one go.
+	refreshTimer_ = new QTimer(this);
+	refreshTimer_->setInterval(200);
+	refreshTimer_->setSingleShot(true);
+	connect(refreshTimer_, SIGNAL(timeout()), this, SLOT(refreshTimer_timeout()));
+
+	connect(&watcher_, SIGNAL(directoryChanged(const QString&)), this, SLOT(watcher_directoryChanged(const QString&)));
+	connect(&watcher_, SIGNAL(fileChanged(const QString&)), this, SLOT(watcher_fileChanged(const QString&)));
+}
+
+DirectoryModel::~DirectoryModel() {
+	clear();
+	threadPool_.waitForDone();
+}
+
+void DirectoryModel::setFileExtensions(const QStringList& extensions) {
+	extensions_.clear();
+	for (int i = 0; i < extensions.size(); i++) extensions_.insert(extensions[i].toLower());
+}
+
+// The directory can also be a ZIP archive, which is then listed like a
+// directory that contains all its entries.
+void DirectoryModel::setDirectory(const QString& dirPath) {
+	QString path = QDir(dirPath).absolutePath();
+	if (path == dirPath_) return;
+
+	clear();
+	dirPath_ = path;
+	archive_ = ZipArchive::isArchive(path);
+	dirPrefix_ = path.endsWith('/') ? path : path + "/";
+
+	loading_ = true;
+	listRequestId_++;
+	listCanceled_ = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	threadPool_.start(new DirectoryListTask(this, dirPath_, extensions_, listRequestId_, listCanceled_));
+
+	watcher_.addPath(dirPath_);
+}
+
+QString DirectoryModel::directory() const {
+	return dirPath_;
+}
+
+QStringList DirectoryModel::fileNames() const {
+	return fileNames_;
+}
+
+// Builds the full list of paths, so it shouldn't be used to access
+// individual files.
+QStringList DirectoryModel::filePaths() const {
+	QStringList output;
+	output.reserve(fileNames_.size());
+	for (int i = 0; i < fileNames_.size(); i++) output.append(dirPrefix_ + fileNames_[i]);
+	return output;
+}
+
+QString DirectoryModel::filePath(int index) const {
+	if (index < 0 || index >= fileNames_.size()) return "";
+	return dirPrefix_ + fileNames_[index];
+}
+
+int DirectoryModel::count() const {
+	return fileNames_.size();
+}
+
+bool DirectoryModel::isLoading() const {
+	return loading_;
+}
+
+bool DirectoryModel::isArchive() const {
+	return archive_;
+}
+
+// Emits changed() if the order of the files changes right away, which
+// happens if the directory is already indexed. Otherwise, it's indexed
+// first.
+void DirectoryModel::setSortMode(SortMode mode) {
+	if (mode == sortMode_) return;
+	sortMode_ = mode;
+
+	// Applied once loading is complete
+	if (dirPath_ == "" || loading_) return;
+
+	if (mode != SortByName && (metadataIndex_->directory() != dirPath_ || !metadataIndex_->isComplete())) {
+		if (metadataIndex_->directory() != dirPath_) metadataIndex_->build(dirPath_, fileNames_);
+		return;
+	}
+
+	activeSortMode_ = mode;
+	sortFileNames();
+	emit changed();
+}
+
+DirectoryModel::SortMode DirectoryModel::sortMode() const {
+	return sortMode_;
+}
+
+int DirectoryModel::indexOf(const QString& filePath) const {
+	return indexes_.value(fileName(filePath), -1);
+}
+
+// Index of the file if it's in the list, or of the file that follows it
+// otherwise (which can be past the end of the list).
+int DirectoryModel::nearestIndex(const QString& filePath) const {
+	int index = indexOf(filePath);
+	if (index >= 0) return index;
+	QString fileName = this->fileName(filePath);
+	return lowerBound(fileName != "" ? fileName : QFileInfo(filePath).fileName());
+}
+
+bool DirectoryModel::insertFile(const QString& filePath) {
+	QString fileName = this->fileName(filePath);
+	if (fileName == "" || indexes_.contains(fileName) || !isSupportedFileName(fileName, extensions_)) return false;
+
+	int index = lowerBound(fileName);
+	fileNames_.insert(index, fileName);
+	if (loading_) loadingKeys_.insert(index, sortKey(fileName));
+	updateIndexes(index);
+	return true;
+}
+
+bool DirectoryModel::removeFile(const QString& filePath) {
+	QString fileName = this->fileName(filePath);
+	int index = indexes_.value(fileName, -1);
+	if (index < 0) return false;
+
+	indexes_.remove(fileName);
+	fileNames_.removeAt(index);
+	if (loading_) loadingKeys_.removeAt(index);
+	updateIndexes(index);
+	return true;
+}
+
+// Lists the directory in the background to find the changes that happened
+// since it was last listed. refreshTask_done() then emits changed() if there
+// were any. While the directory is being loaded or refreshed, this is done
+// once that is complete.
+void DirectoryModel::refresh() {
+	if (dirPath_ == "") return;
+
+	if (loading_ || refreshing_) {
+		refreshPending_ = true;
+		return;
+	}
+
+	refreshing_ = true;
+	threadPool_.start(new DirectoryRefreshTask(this, dirPath_, extensions_, fileNames_, listRequestId_, listCanceled_));
+}
+
+// The list might have changed since it was given to the refresh task (eg.
+// through insertFile() and removeFile()), so changes that have already been
+// applied are skipped. Emits changed() if there were others.
+void DirectoryModel::applyChanges(const QStringList& addedNames, const QStringList& removedNames) {
+	QStringList removed;
+	for (int i = 0; i < removedNames.size(); i++) {
+		if (indexes_.contains(removedNames[i])) removed.append(removedNames[i]);
+	}
+
+	QStringList added;
+	for (int i = 0; i < addedNames.size(); i++) {
+		if (!indexes_.contains(addedNames[i])) added.append(addedNames[i]);
+	}
+
+	if (removed.isEmpty() && added.isEmpty()) return;
+
+	// Each insertion or removal moves part of the list, so past a point
+	// it's faster to sort everything again.
+	if (removed.size() + added.size() > qMax(16, fileNames_.size() / 8)) {
+		QSet<QString> removedSet = toSet(removed);
+		QStringList fileNames;
+		fileNames.reserve(fileNames_.size() + added.size());
+		for (int i = 0; i < fileNames_.size(); i++) {
+			if (!removedSet.contains(fileNames_[i])) fileNames.append(fileNames_[i]);
+		}
+		fileNames.append(added);
+		setFileNames(fileNames);
+	} else {
+		// The indexes are updated once all the changes have been applied.
+		// Until then, positions are found by binary search.
+		int from = fileNames_.size();
+
+		for (int i = 0; i < removed.size(); i++) {
+			int index = position(removed[i]);
+			if (index < 0) continue;
+			indexes_.remove(removed[i]);
+			fileNames_.removeAt(index);
+			from = qMin(from, index);
+		}
+
+		for (int i = 0; i < added.size(); i++) {
+			int index = lowerBound(added[i]);
+			fileNames_.insert(index, added[i]);
+			from = qMin(from, index);
+		}
+
+		updateIndexes(from);
+	}
+
+	emit changed();
+}
+
+void DirectoryModel::clear() {
+	if (listCanceled_) listCanceled_->store(1);
+	loading_ = false;
+	refreshing_ = false;
+	refreshPending_ = false;
+	loadingKeys_.clear();
+
+	metadataIndex_->clear();
+	activeSortMode_ = SortByName;
+
+	refreshTimer_->stop();
+	if (watcher_.directories().size()) watcher_.removePaths(watcher_.directories());
+	if (watcher_.files().size()) watcher_.removePaths(watcher_.files());
+	dirPath_ = "";
+	archive_ = false;
+	dirPrefix_ = "";
+	fileNames_.clear();
+	indexes_.clear();
+}
+
+// Name of the file if it's directly in the directory, or an empty string
+// otherwise. In archives, the name of an entry includes its folders. Paths
+// are normally absolute already, so QFileInfo is only needed for the others.
+QString DirectoryModel::fileName(const QString& filePath) const {
+	if (dirPath_ == "") return "";
+
+	if (filePath.startsWith(dirPrefix_)) {
+		QString output = filePath.mid(dirPrefix_.length());
+		return output.contains('/') && !archive_ ? "" : output;
+	}
+
+	if (archive_) return "";
+
+	QFileInfo fileInfo(filePath);
+	return fileInfo.absolutePath() == dirPath_ ? fileInfo.fileName() : "";
+}
+
+// The key of the searched name is only computed once, and the keys of the
+// names in the list are computed as they are compared, since there are only
+// a few of them.
+int DirectoryModel::lowerBound(const QString& fileName) const {
+	QByteArray key = sortKey(fileName);
+	int first = 0;
+	int count = fileNames_.size();
+	while (count > 0) {
+		int step = count / 2;
+		int middle = first + step;
+		if (sortKey(fileNames_[middle]) < key) {
+			first = middle + 1;
+			count -= step + 1;
+		} else {
+			count = step;
+		}
+	}
+	return first;
+}
+
+// Same as indexOf() but doesn't rely on the indexes, which are not valid
+// while changes are being applied.
+int DirectoryModel::position(const QString& fileName) const {
+	int index = lowerBound(fileName);
+	return index < fileNames_.size() && fileNames_[index] == fileName ? index : -1;
+}
+
+// Key of the file in the order the list is in. For metadata, the value is
+// written big-endian, with its sign bit flipped so that the keys compare
+// like the values, and followed by the name so that the order is total.
+// Files whose metadata isn't known yet (eg. new files, which the index
+// reads in the background) go last until the list is sorted again.
+QByteArray DirectoryModel::sortKey(const QString& fileName) const {
+	if (activeSortMode_ == SortByName) return stringutil::naturalSortKey(fileName);
+
+	FileMetadata metadata = metadataIndex_->metadata(fileName);
+	qint64 value = metadata.size;
+	if (activeSortMode_ == SortByModificationTime) value = metadata.lastModified;
+	if (activeSortMode_ == SortByCaptureTime) value = metadata.captureTime >= 0 ? metadata.captureTime : metadata.lastModified;
+	if (metadata.lastModified < 0) value = Q_INT64_C(0x7FFFFFFFFFFFFFFF);
+
+	quint64 v = (quint64)value ^ Q_UINT64_C(0x8000000000000000);
+	QByteArray output;
+	for (int i = 7; i >= 0; i--) output.append((char)((v >> (i * 8)) & 0xFF));
+	output.append(stringutil::naturalSortKey(fileName));
+	return output;
+}
+
+void DirectoryModel::setFileNames(const QStringList& fileNames) {
+	fileNames_ = fileNames;
+	sortFileNames();
+}
+
+// Sorts the whole list in the active order. The keys are computed once per
+// file.
+void DirectoryModel::sortFileNames() {
+	if (activeSortMode_ == SortByName) {
+		stringutil::naturalSort(fileNames_);
+	} else {
+		std::vector<std::pair<QByteArray, QString> > keys;
+		keys.reserve(fileNames_.size());
+		for (int i = 0; i < fileNames_.size(); i++) keys.push_back(std::make_pair(sortKey(fileNames_[i]), fileNames_[i]));
+
+		std::sort(keys.begin(), keys.end());
+
+		for (int i = 0; i < (int)keys.size(); i++) fileNames_[i] = keys[i].second;
+	}
+
+	indexes_.clear();
+	indexes_.reserve(fileNames_.size());
+	updateIndexes(0);
+}
+
+// Merges a batch of names, in any order, into the sorted list. Names that
+// are already there (eg. inserted with insertFile()) are skipped.
+void DirectoryModel::mergeFileNames(const QStringList& fileNames) {
+	std::vector<std::pair<QByteArray, QString> > batch;
+	batch.reserve(fileNames.size());
+	for (int i = 0; i < fileNames.size(); i++) {
+		if (indexes_.contains(fileNames[i])) continue;
+		batch.push_back(std::make_pair(sortKey(fileNames[i]), fileNames[i]));
+	}
+	if (batch.empty()) return;
+
+	std::sort(batch.begin(), batch.end());
+
+	QStringList mergedNames;
+	QList<QByteArray> mergedKeys;
+	mergedNames.reserve(fileNames_.size() + (int)batch.size());
+	mergedKeys.reserve(fileNames_.size() + (int)batch.size());
+
+	int from = -1;
+	int i = 0;
+	size_t j = 0;
+	while (i < fileNames_.size() || j < batch.size()) {
+		if (j >= batch.size() || (i < fileNames_.size() && !(batch[j].first < loadingKeys_[i]))) {
+			mergedNames.append(fileNames_[i]);
+			mergedKeys.append(loadingKeys_[i]);
+			i++;
+		} else {
+			if (from < 0) from = mergedNames.size();
+			mergedNames.append(batch[j].second);
+			mergedKeys.append(batch[j].first);
+			j++;
+		}
+	}
+
+	fileNames_ = mergedNames;
+	loadingKeys_ = mergedKeys;
+	updateIndexes(from);
+}
+
+// The hash keys share their data with the names in the list, so each name
+// is only stored once.
+void DirectoryModel::updateIndexes(int from) {
+	for (int i = from; i < fileNames_.size(); i++) indexes_.insert(fileNames_[i], i);
+}
+
+void DirectoryModel::watcher_directoryChanged(const QString& path) {
+	Q_UNUSED(path);
+	refreshTimer_->start();
+}
+
+// Archives are watched as files. Those that are rewritten by replacing them
+// stop being watched, so they are added again.
+void DirectoryModel::watcher_fileChanged(const QString& path) {
+	if (!watcher_.files().contains(path) && QFileInfo::exists(path)) watcher_.addPath(path);
+	refreshTimer_->start();
+}
+
+void DirectoryModel::refreshTimer_timeout() {
+	refresh();
+}
+
+void DirectoryModel::listTask_fileNames(int requestId, const QStringList& fileNames, bool done) {
+	if (requestId != listRequestId_ || !loading_) return;
+
+	mergeFileNames(fileNames);
+
+	if (done) {
+		loading_ = false;
+		loadingKeys_.clear();
+		if (sortMode_ != SortByName) metadataIndex_->build(dirPath_, fileNames_);
+	}
+
+	emit changed();
+
+	// Changes that happened while loading
+	if (done && refreshPending_) {
+		refreshPending_ = false;
+		refresh();
+	}
+}
+
+// If the directory itself has been deleted or renamed, all its files are
+// removed.
+void DirectoryModel::refreshTask_done(int requestId, bool exists, const QStringList& added, const QStringList& removed) {
+	if (requestId != listRequestId_ || !refreshing_) return;
+	refreshing_ = false;
+
+	if (!exists) {
+		bool hadFiles = fileNames_.size() > 0;
+		fileNames_.clear();
+		indexes_.clear();
+		if (hadFiles) emit changed();
+	} else {
+		applyChanges(added, removed);
+	}
+
+	// Changes that happened while refreshing
+	if (refreshPending_) {
+		refreshPending_ = false;
+		refresh();
+	}
+}
+
+void DirectoryModel::metadataIndex_indexed() {
+	if (sortMode_ == SortByName || sortMode_ == activeSortMode_) return;
+
+	activeSortMode_ = sortMode_;
+	sortFileNames();
+	emit changed();
+}
+
+// The metadata of new files has been read, so their provisional position
+// is replaced by the actual one.
+void DirectoryModel::metadataIndex_updated() {
+	if (activeSortMode_ == SortByName) return;
+
+	sortFileNames();
+	emit changed();
+}
+
+}
@@ -0,0 +1,164 @@
+#ifndef MV_DIRECTORYMODEL_H
+#define MV_DIRECTORYMODEL_H
+
+#include "metadataindex.h"
+
+namespace mv {
+
+class DirectoryModel;
+
+// Lists the supported files of a directory and posts their names to the
+// model in batches, so that the first ones are available before the whole
+// directory has been listed (which can take a while on network drives).
+class DirectoryListTask : public QRunnable {
+
+public:
+
+	DirectoryListTask(DirectoryModel* model, const QString& dirPath, const QSet<QString>& extensions, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	DirectoryModel* model_;
+	QString dirPath_;
+	QSet<QString> extensions_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Lists the directory again and compares it with the given file names, so
+// that only the names that have been added or removed are posted back to the
+// model.
+class DirectoryRefreshTask : public QRunnable {
+
+public:
+
+	DirectoryRefreshTask(DirectoryModel* model, const QString& dirPath, const QSet<QString>& extensions, const QStringList& fileNames, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	DirectoryModel* model_;
+	QString dirPath_;
+	QSet<QString> extensions_;
+	QStringList fileNames_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Sorted list (in natural order) of the supported files of a directory, or
+// of a ZIP archive (see ZipArchive). The directory is listed once when it is
+// opened, in the background: files are merged into the list as they are
+// found, and isLoading() tells whether the list is complete yet. After that,
+// the model watches the directory and applies the changes to the list
+// incrementally: created files are inserted at their sorted position,
+// deleted files are removed, and renamed files are both. The list is
+// therefore never re-sorted and its files never stat'ed again while the
+// directory is open.
+//
+// Directory change notifications don't tell which files have changed, so
+// on each (coalesced) notification the file names are listed again and
+// compared with the current ones, in the background (see
+// DirectoryRefreshTask). Changes the application already knows about can be
+// applied directly with insertFile() and removeFile().
+//
+// The directory path is stored once and only the file names are kept, each
+// of them shared between the sorted list and a hash from name to index. The
+// index of a file and the file at an index are therefore found in constant
+// time, whatever the size of the directory. Full paths are only built on
+// request.
+//
+// Files can also be sorted by capture time, modification time or size,
+// which come from a MetadataIndex of the directory. The list stays sorted
+// by name until the index has been built, and is then sorted again. Since
+// the index is kept, switching between sort modes afterwards doesn't read
+// anything from the disk.
+class DirectoryModel : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	enum SortMode {
+		SortByName,
+		// Files without capture time use their modification time instead
+		SortByCaptureTime,
+		SortByModificationTime,
+		SortBySize
+	};
+
+	DirectoryModel(QObject* parent = 0);
+	~DirectoryModel();
+	void setFileExtensions(const QStringList& extensions);
+	void setDirectory(const QString& dirPath);
+	QString directory() const;
+	QStringList fileNames() const;
+	QStringList filePaths() const;
+	QString filePath(int index) const;
+	int count() const;
+	bool isLoading() const;
+	bool isArchive() const;
+	void setSortMode(SortMode mode);
+	SortMode sortMode() const;
+	int indexOf(const QString& filePath) const;
+	int nearestIndex(const QString& filePath) const;
+	bool insertFile(const QString& filePath);
+	bool removeFile(const QString& filePath);
+	void refresh();
+	void clear();
+
+private:
+
+	QString fileName(const QString& filePath) const;
+	int lowerBound(const QString& fileName) const;
+	int position(const QString& fileName) const;
+	QByteArray sortKey(const QString& fileName) const;
+	void setFileNames(const QStringList& fileNames);
+	void sortFileNames();
+	void mergeFileNames(const QStringList& fileNames);
+	void applyChanges(const QStringList& addedNames, const QStringList& removedNames);
+	void updateIndexes(int from);
+
+	QString dirPath_;
+	QString dirPrefix_;
+	bool archive_;
+	QStringList fileNames_;
+	QHash<QString, int> indexes_;
+	QSet<QString> extensions_;
+	QFileSystemWatcher watcher_;
+	QTimer* refreshTimer_;
+	QThreadPool threadPool_;
+	QSharedPointer<QAtomicInt> listCanceled_;
+	int listRequestId_;
+	bool loading_;
+	bool refreshing_;
+	bool refreshPending_;
+	// Sort keys of the names in the list, only kept while loading
+	QList<QByteArray> loadingKeys_;
+	SortMode sortMode_;
+	// Order the list is actually in, which differs from the requested one
+	// while the metadata index is being built
+	SortMode activeSortMode_;
+	MetadataIndex* metadataIndex_;
+
+public slots:
+
+	void watcher_directoryChanged(const QString& path);
+	void watcher_fileChanged(const QString& path);
+	void refreshTimer_timeout();
+	void listTask_fileNames(int requestId, const QStringList& fileNames, bool done);
+	void refreshTask_done(int requestId, bool exists, const QStringList& added, const QStringList& removed);
+	void metadataIndex_indexed();
+	void metadataIndex_updated();
+
+signals:
+
+	void changed();
+
+};
+
+}
+
+#endif // MV_DIRECTORYMODEL_H
@@ -0,0 +1,134 @@
+#include "directoryscanner.h"
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mv {
+
+namespace {
+
+#ifdef Q_OS_LINUX
+
+// Not declared by glibc, which only wraps getdents64 since 2.30
+struct LinuxDirent64 {
+	quint64 d_ino;
+	qint64 d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1];
+};
+
+// Large enough to read most directories in a few calls, which matters most
+// on network filesystems where each call is a round trip.
+const int BufferSize = 256 * 1024;
+
+#endif
+
+}
+
+DirectoryScanner::DirectoryScanner(const QString& dirPath, const QSet<QString>& extensions) {
+	dirPath_ = dirPath;
+	maxExtensionLength_ = 0;
+	for (QSet<QString>::const_iterator i = extensions.constBegin(); i != extensions.constEnd(); ++i) {
+		QByteArray extension = i->toLower().toLatin1();
+		extensions_.insert(extension);
+		maxExtensionLength_ = qMax(maxExtensionLength_, extension.length());
+	}
+
+#ifdef Q_OS_LINUX
+	bufferOffset_ = 0;
+	bufferSize_ = 0;
+	fd_ = open(QFile::encodeName(dirPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd_ < 0) {
+		qWarning() << "Could not open directory" << dirPath;
+	} else {
+		buffer_.resize(BufferSize);
+	}
+#else
+	iterator_ = new QDirIterator(dirPath, QDir::Files);
+#endif
+}
+
+DirectoryScanner::~DirectoryScanner() {
+#ifdef Q_OS_LINUX
+	if (fd_ >= 0) close(fd_);
+#else
+	delete iterator_;
+#endif
+}
+
+// Gets the name of the next file. Returns false once all the files have
+// been listed.
+bool DirectoryScanner::next(QString* fileName) {
+#ifdef Q_OS_LINUX
+	if (fd_ < 0) return false;
+
+	while (true) {
+		if (bufferOffset_ >= bufferSize_) {
+			long size = syscall(SYS_getdents64, fd_, buffer_.data(), buffer_.size());
+			if (size < 0) qWarning() << "Could not read directory" << dirPath_;
+			if (size <= 0) return false;
+			bufferSize_ = (int)size;
+			bufferOffset_ = 0;
+		}
+
+		const LinuxDirent64* entry = (const LinuxDirent64*)(buffer_.constData() + bufferOffset_);
+		bufferOffset_ += entry->d_reclen;
+
+		// Hidden files are skipped like with QDir::Files, which also skips
+		// "." and "..". The extension is checked before the type, since it
+		// doesn't require a stat.
+		if (entry->d_name[0] == '.') continue;
+		if (!isSupportedFileName(entry->d_name)) continue;
+		if (!isFile(entry->d_name, entry->d_type)) continue;
+
+		*fileName = QFile::decodeName(entry->d_name);
+		return true;
+	}
+#else
+	while (iterator_->hasNext()) {
+		iterator_->next();
+		QString name = iterator_->fileName();
+		if (!isSupportedFileName(QFile::encodeName(name).constData())) continue;
+		*fileName = name;
+		return true;
+	}
+	return false;
+#endif
+}
+
+bool DirectoryScanner::isSupportedFileName(const char* fileName) const {
+	const char* dot = strrchr(fileName, '.');
+	if (!dot) return false;
+
+	int length = (int)strlen(dot + 1);
+	if (length <= 0 || length > maxExtensionLength_) return false;
+
+	QByteArray extension(dot + 1, length);
+	for (int i = 0; i < length; i++) {
+		char c = extension[i];
+		if (c >= 'A' && c <= 'Z') extension[i] = c - 'A' + 'a';
+	}
+	return extensions_.contains(extension);
+}
+
+#ifdef Q_OS_LINUX
+
+bool DirectoryScanner::isFile(const char* fileName, unsigned char type) const {
+	if (type == DT_REG) return true;
+	if (type != DT_UNKNOWN && type != DT_LNK) return false;
+
+	// Follows symbolic links
+	struct stat info;
+	if (fstatat(fd_, fileName, &info, 0) != 0) return false;
+	return S_ISREG(info.st_mode);
+}
+
+#endif
+
+}
@@ -0,0 +1,46 @@
+#ifndef MV_DIRECTORYSCANNER_H
+#define MV_DIRECTORYSCANNER_H
+
+namespace mv {
+
+// Lists the names of the regular files of a directory that have one of the
+// given extensions. Symbolic links to regular files are included, like with
+// QDir::Files.
+//
+// On Linux, the directory entries are read directly with getdents64 into a
+// large buffer. Files are recognized from the entry type (d_type), and
+// extensions are checked on the raw names, so only the matching files are
+// decoded into QStrings. Entries are only stat'ed when their type is not
+// known, which some filesystems don't report, or for symbolic links, and
+// only if their extension matches. Other systems use QDirIterator.
+class DirectoryScanner {
+
+public:
+
+	DirectoryScanner(const QString& dirPath, const QSet<QString>& extensions);
+	~DirectoryScanner();
+	bool next(QString* fileName);
+
+private:
+
+	bool isSupportedFileName(const char* fileName) const;
+
+	QString dirPath_;
+	QSet<QByteArray> extensions_;
+	int maxExtensionLength_;
+
+#ifdef Q_OS_LINUX
+	bool isFile(const char* fileName, unsigned char type) const;
+	int fd_;
+	QByteArray buffer_;
+	int bufferOffset_;
+	int bufferSize_;
+#else
+	QDirIterator* iterator_;
+#endif
+
+};
+
+}
+
+#endif // MV_DIRECTORYSCANNER_H
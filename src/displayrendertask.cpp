@@ -0,0 +1,37 @@
+#include "displayrendertask.h"
+#include "performancelog.h"
+#include "resampler.h"
+
+namespace mv {
+
+DisplayRenderTask::DisplayRenderTask(QObject* receiver, const QString& filePath, const QString& key, const QImage& image, const QSize& size, int rotation, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	receiver_ = receiver;
+	filePath_ = filePath;
+	key_ = key;
+	image_ = image;
+	size_ = size;
+	rotation_ = rotation;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void DisplayRenderTask::run() {
+	// Renders for sizes that have already been superseded (eg. while the
+	// window is being resized) are skipped.
+	if (canceled_->load()) return;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QImage output = resampler::scaled(image_, size_, Qt::KeepAspectRatio);
+	// Rotations are by multiples of 90 degrees so they don't resample
+	if (rotation_) output = output.transformed(QTransform().rotate(rotation_));
+
+	performanceLog::record("scale", filePath_, timer.nsecsElapsed() / 1000);
+
+	if (canceled_->load()) return;
+
+	QMetaObject::invokeMethod(receiver_, "displayRenderTask_done", Qt::QueuedConnection, Q_ARG(QString, key_), Q_ARG(QImage, output), Q_ARG(int, requestId_));
+}
+
+}
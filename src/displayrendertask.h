@@ -0,0 +1,31 @@
+#ifndef MV_DISPLAYRENDERTASK_H
+#define MV_DISPLAYRENDERTASK_H
+
+namespace mv {
+
+// Renders the high quality display bitmap of an image (scaled to fit the
+// given size, then rotated) off the GUI thread. The result is posted to the
+// receiver's displayRenderTask_done() slot.
+class DisplayRenderTask : public QRunnable {
+
+public:
+
+	DisplayRenderTask(QObject* receiver, const QString& filePath, const QString& key, const QImage& image, const QSize& size, int rotation, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	QObject* receiver_;
+	QString filePath_;
+	QString key_;
+	QImage image_;
+	QSize size_;
+	int rotation_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+}
+
+#endif // MV_DISPLAYRENDERTASK_H
@@ -0,0 +1,458 @@
+#include "duplicatefinder.h"
+#include "metadataindex.h"
+#include "simpletypes.h"
+#include "ziparchive.h"
+
+namespace mv {
+
+namespace {
+
+const quint32 CacheMagic = 0x4d564831;
+
+// Files per hash task
+const int ChunkSize = 16;
+// Interval at which progress is posted, in milliseconds
+const int ProgressInterval = 200;
+// Images are decoded to this size before being hashed. The JPEG decoder can
+// produce it directly from the lowest frequencies of the file.
+const int DecodeSize = 64;
+const int DctSize = 32;
+const double Pi = 3.14159265358979323846;
+
+// The pHashes are indexed by 4 substrings of 16 bits
+const int SubstringCount = 4;
+const int SubstringBits = 16;
+
+// Multi-index hashing over the pHashes. By the pigeonhole principle, two
+// hashes within the threshold have at least one substring within a quarter
+// of the threshold of each other, so the candidates are the hashes that have
+// a substring equal to one of the substrings of the searched hash with up to
+// that many bits changed. Each substring has its own table, from the value
+// of the substring to the hashes that have it.
+//
+// Unrelated hashes are all about 32 bits apart, so a metric tree such as a
+// BK-tree can't prune much at the usual thresholds, while the number of
+// lookups here only depends on the threshold.
+class MultiIndex {
+
+public:
+
+	MultiIndex(const std::vector<ImageHash>& hashes, int threshold) {
+		int radius = threshold / SubstringCount;
+		for (int mask = 0; mask < (1 << SubstringBits); mask++) {
+			if (qPopulationCount((quint32)mask) <= radius) masks_.push_back(mask);
+		}
+
+		// The tables are stored as the concatenation of their buckets, each
+		// bucket in increasing order of item.
+		for (int s = 0; s < SubstringCount; s++) {
+			IntVector& offsets = offsets_[s];
+			offsets.assign((1 << SubstringBits) + 1, 0);
+			for (int i = 0; i < (int)hashes.size(); i++) {
+				if (hashes[i].valid) offsets[substring(hashes[i].pHash, s) + 1]++;
+			}
+			for (int i = 1; i < (int)offsets.size(); i++) offsets[i] += offsets[i - 1];
+
+			IntVector next(offsets.begin(), offsets.end() - 1);
+			items_[s].resize(offsets.back());
+			for (int i = 0; i < (int)hashes.size(); i++) {
+				if (hashes[i].valid) items_[s][next[substring(hashes[i].pHash, s)]++] = i;
+			}
+		}
+	}
+
+	// Number of buckets looked up by each search
+	int lookupCount() const {
+		return (int)masks_.size() * SubstringCount;
+	}
+
+	// Adds the items before `end` that can be within the threshold of the
+	// hash. Items can be added more than once.
+	void find(quint64 hash, int end, IntVector* items) const {
+		for (int s = 0; s < SubstringCount; s++) {
+			int value = substring(hash, s);
+			for (int i = 0; i < (int)masks_.size(); i++) {
+				int bucket = value ^ masks_[i];
+				for (int j = offsets_[s][bucket]; j < offsets_[s][bucket + 1]; j++) {
+					if (items_[s][j] >= end) break;
+					items->push_back(items_[s][j]);
+				}
+			}
+		}
+	}
+
+private:
+
+	static int substring(quint64 hash, int index) {
+		return (int)((hash >> (index * SubstringBits)) & ((1 << SubstringBits) - 1));
+	}
+
+	// The bits by which the substrings can differ
+	IntVector masks_;
+	IntVector offsets_[SubstringCount];
+	IntVector items_[SubstringCount];
+
+};
+
+int findRoot(IntVector& parents, int index) {
+	while (parents[index] != index) {
+		parents[index] = parents[parents[index]];
+		index = parents[index];
+	}
+	return index;
+}
+
+}
+
+ImageHash::ImageHash() {
+	valid = false;
+	dHash = 0;
+	pHash = 0;
+	size = -1;
+	lastModified = -1;
+}
+
+ImageHashTask::ImageHashTask(const QStringList& filePaths, ImageHash* output, QAtomicInt* doneCount, QSharedPointer<QAtomicInt> canceled) {
+	filePaths_ = filePaths;
+	output_ = output;
+	doneCount_ = doneCount;
+	canceled_ = canceled;
+}
+
+// Only the hashes are set, the size and modification time are already there
+void ImageHashTask::run() {
+	for (int i = 0; i < filePaths_.size(); i++) {
+		if (canceled_->load()) return;
+
+		ImageHash hash = DuplicateFinder::computeHash(filePaths_[i]);
+		output_[i].valid = hash.valid;
+		output_[i].dHash = hash.dHash;
+		output_[i].pHash = hash.pHash;
+		doneCount_->fetchAndAddRelaxed(1);
+	}
+}
+
+DuplicateFindTask::DuplicateFindTask(DuplicateFinder* finder, QThreadPool* hashThreadPool, const QString& dirPath, const QStringList& fileNames, int threshold, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	finder_ = finder;
+	hashThreadPool_ = hashThreadPool;
+	dirPath_ = dirPath;
+	fileNames_ = fileNames;
+	threshold_ = threshold;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void DuplicateFindTask::run() {
+	if (canceled_->load()) return;
+
+	ImageHashHash cached = DuplicateFinder::loadCache(dirPath_);
+	QString dirPrefix = dirPath_.endsWith('/') ? dirPath_ : dirPath_ + "/";
+
+	std::vector<ImageHash> hashes(fileNames_.size());
+	QStringList pendingPaths;
+	IntVector pendingIndexes;
+	std::vector<ImageHash> pendingHashes;
+
+	for (int i = 0; i < fileNames_.size(); i++) {
+		if (canceled_->load()) return;
+
+		ImageHash hash;
+		if (!MetadataIndex::readFileInfo(dirPrefix + fileNames_[i], &hash.size, &hash.lastModified)) continue;
+
+		ImageHashHash::const_iterator it = cached.constFind(fileNames_[i]);
+		if (it != cached.constEnd() && it->size == hash.size && it->lastModified == hash.lastModified) {
+			hashes[i] = *it;
+			continue;
+		}
+
+		pendingPaths.append(dirPrefix + fileNames_[i]);
+		pendingIndexes.push_back(i);
+		pendingHashes.push_back(hash);
+	}
+
+	if (pendingPaths.size()) {
+		QAtomicInt doneCount(0);
+		for (int i = 0; i < pendingPaths.size(); i += ChunkSize) {
+			hashThreadPool_->start(new ImageHashTask(pendingPaths.mid(i, ChunkSize), &pendingHashes[i], &doneCount, canceled_));
+		}
+
+		// The tasks write to the local variables, so they must all be done
+		// before returning, even when canceled.
+		while (!hashThreadPool_->waitForDone(ProgressInterval)) {
+			if (canceled_->load()) continue;
+			QMetaObject::invokeMethod(finder_, "findTask_progress", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(int, doneCount.load()), Q_ARG(int, pendingPaths.size()));
+		}
+
+		if (canceled_->load()) return;
+
+		for (int i = 0; i < (int)pendingIndexes.size(); i++) hashes[pendingIndexes[i]] = pendingHashes[i];
+
+		// Files that couldn't be decoded are also saved, so that they are
+		// not decoded again next time.
+		ImageHashHash output;
+		output.reserve(fileNames_.size());
+		for (int i = 0; i < fileNames_.size(); i++) {
+			if (hashes[i].size >= 0) output.insert(fileNames_[i], hashes[i]);
+		}
+		if (!DuplicateFinder::saveCache(dirPath_, output)) qWarning() << "Could not save image hashes of" << dirPath_ << "to" << DuplicateFinder::cachePath(dirPath_);
+	}
+
+	if (canceled_->load()) return;
+
+	DuplicateGroups fileNameGroups = DuplicateFinder::group(fileNames_, hashes, threshold_);
+	DuplicateGroups groups;
+	for (int i = 0; i < fileNameGroups.size(); i++) {
+		QStringList filePaths;
+		for (int j = 0; j < fileNameGroups[i].size(); j++) filePaths.append(dirPrefix + fileNameGroups[i][j]);
+		groups.append(filePaths);
+	}
+
+	QMetaObject::invokeMethod(finder_, "findTask_done", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(mv::DuplicateGroups, groups));
+}
+
+DuplicateFinder::DuplicateFinder(QObject* parent) : QObject(parent) {
+	qRegisterMetaType<mv::DuplicateGroups>("mv::DuplicateGroups");
+
+	requestId_ = 0;
+	running_ = false;
+	findThreadPool_.setMaxThreadCount(1);
+	hashThreadPool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+DuplicateFinder::~DuplicateFinder() {
+	cancel();
+	findThreadPool_.waitForDone();
+	hashThreadPool_.waitForDone();
+}
+
+// Finds the duplicates among the given files of the directory (or archive).
+// progress() is emitted while hashes are being computed, and found() once
+// done. Any search in progress is canceled.
+void DuplicateFinder::find(const QString& dirPath, const QStringList& fileNames, int threshold) {
+	cancel();
+
+	requestId_++;
+	running_ = true;
+	canceled_ = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	findThreadPool_.start(new DuplicateFindTask(this, &hashThreadPool_, dirPath, fileNames, threshold, requestId_, canceled_));
+}
+
+void DuplicateFinder::cancel() {
+	if (canceled_) canceled_->store(1);
+	running_ = false;
+}
+
+bool DuplicateFinder::isRunning() const {
+	return running_;
+}
+
+// The hashes are invalid if the image can't be decoded
+ImageHash DuplicateFinder::computeHash(const QString& filePath) {
+	ImageHash output;
+
+	QFile file(filePath);
+	QBuffer buffer;
+	QIODevice* device = &file;
+
+	if (ZipArchive::isArchiveEntry(filePath)) {
+		QString error;
+		QByteArray data = ZipArchive::readFile(filePath, &error);
+		if (error != "") return output;
+		buffer.setData(data);
+		buffer.open(QIODevice::ReadOnly);
+		device = &buffer;
+	} else if (!file.open(QIODevice::ReadOnly)) {
+		return output;
+	}
+
+	QImageReader reader(device, QFileInfo(filePath).suffix().toLower().toLatin1());
+	// The aspect ratio doesn't need to be kept since the image is hashed as
+	// a square anyway
+	if (reader.size().isValid()) reader.setScaledSize(QSize(DecodeSize, DecodeSize).boundedTo(reader.size()));
+	return computeHash(reader.read());
+}
+
+// Hashes an image that has already been decoded, preferably at a small size
+// since it's scaled down to 32x32 anyway. The DCT below takes a few
+// microseconds, against milliseconds for even the scaled-down decode, so it
+// is left as plain loops.
+ImageHash DuplicateFinder::computeHash(const QImage& image) {
+	ImageHash output;
+	if (image.isNull()) return output;
+
+	QImage dctImage = image.convertToFormat(QImage::Format_RGB32).scaled(DctSize, DctSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	QImage dImage = dctImage.scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+	for (int y = 0; y < 8; y++) {
+		const QRgb* line = (const QRgb*)dImage.constScanLine(y);
+		for (int x = 0; x < 8; x++) {
+			if (qGray(line[x]) > qGray(line[x + 1])) output.dHash |= Q_UINT64_C(1) << (y * 8 + x);
+		}
+	}
+
+	// Only the 8x8 lowest frequencies of the DCT are needed, so it's computed
+	// directly as two products with the 8x32 matrix of the cosines, rows
+	// first. The scale factors are left out since they don't change the
+	// comparisons with the median.
+	double cosines[8][DctSize];
+	for (int u = 0; u < 8; u++) {
+		for (int x = 0; x < DctSize; x++) cosines[u][x] = cos((2 * x + 1) * u * Pi / (2 * DctSize));
+	}
+
+	double rows[DctSize][8];
+	for (int y = 0; y < DctSize; y++) {
+		const QRgb* line = (const QRgb*)dctImage.constScanLine(y);
+		double pixels[DctSize];
+		for (int x = 0; x < DctSize; x++) pixels[x] = qGray(line[x]);
+		for (int u = 0; u < 8; u++) {
+			double sum = 0;
+			for (int x = 0; x < DctSize; x++) sum += cosines[u][x] * pixels[x];
+			rows[y][u] = sum;
+		}
+	}
+
+	double dct[64];
+	for (int v = 0; v < 8; v++) {
+		for (int u = 0; u < 8; u++) {
+			double sum = 0;
+			for (int y = 0; y < DctSize; y++) sum += cosines[v][y] * rows[y][u];
+			dct[v * 8 + u] = sum;
+		}
+	}
+
+	// The DC coefficient (the average brightness) is left out of the median
+	std::vector<double> ac(dct + 1, dct + 64);
+	std::nth_element(ac.begin(), ac.begin() + ac.size() / 2, ac.end());
+	double median = ac[ac.size() / 2];
+	for (int i = 0; i < 64; i++) {
+		if (dct[i] > median) output.pHash |= Q_UINT64_C(1) << i;
+	}
+
+	output.valid = true;
+	return output;
+}
+
+int DuplicateFinder::distance(quint64 hash1, quint64 hash2) {
+	return qPopulationCount(hash1 ^ hash2);
+}
+
+// Groups the files whose hashes (given in the same order) are both within
+// the threshold. Groups of one file are not included.
+DuplicateGroups DuplicateFinder::group(const QStringList& fileNames, const std::vector<ImageHash>& hashes, int threshold) {
+	IntVector parents(fileNames.size());
+	for (int i = 0; i < (int)parents.size(); i++) parents[i] = i;
+
+	// At high thresholds, looking up the candidates costs more than
+	// comparing every pair.
+	MultiIndex index(hashes, threshold);
+	bool compareAll = index.lookupCount() > fileNames.size();
+
+	// Each file is compared with the files before it, so each pair is only
+	// compared once.
+	IntVector candidates;
+	IntVector lastCompared(fileNames.size(), -1);
+	for (int i = 0; i < fileNames.size(); i++) {
+		if (!hashes[i].valid) continue;
+
+		candidates.clear();
+		if (compareAll) {
+			for (int j = 0; j < i; j++) candidates.push_back(j);
+		} else {
+			index.find(hashes[i].pHash, i, &candidates);
+		}
+
+		for (int c = 0; c < (int)candidates.size(); c++) {
+			int j = candidates[c];
+			if (!hashes[j].valid || lastCompared[j] == i) continue;
+			lastCompared[j] = i;
+
+			if (distance(hashes[i].pHash, hashes[j].pHash) > threshold) continue;
+			if (distance(hashes[i].dHash, hashes[j].dHash) > threshold) continue;
+			parents[findRoot(parents, j)] = findRoot(parents, i);
+		}
+	}
+
+	DuplicateGroups groups;
+	QHash<int, int> rootGroups;
+	for (int i = 0; i < fileNames.size(); i++) {
+		int root = findRoot(parents, i);
+		QHash<int, int>::const_iterator it = rootGroups.constFind(root);
+		if (it == rootGroups.constEnd()) {
+			rootGroups.insert(root, groups.size());
+			groups.append(QStringList() << fileNames[i]);
+		} else {
+			groups[it.value()].append(fileNames[i]);
+		}
+	}
+
+	DuplicateGroups output;
+	for (int i = 0; i < groups.size(); i++) {
+		if (groups[i].size() > 1) output.append(groups[i]);
+	}
+	return output;
+}
+
+QString DuplicateFinder::cachePath(const QString& dirPath) {
+	QByteArray hash = QCryptographicHash::hash(dirPath.toUtf8(), QCryptographicHash::Md5);
+	return QString("%1/hashes/%2.dat").arg(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).arg(QString(hash.toHex()));
+}
+
+ImageHashHash DuplicateFinder::loadCache(const QString& dirPath) {
+	ImageHashHash output;
+
+	QFile file(cachePath(dirPath));
+	if (!file.open(QIODevice::ReadOnly)) return output;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	QString storedDirPath;
+	qint32 count;
+	stream >> magic >> storedDirPath >> count;
+	// The path is checked in case of hash collision
+	if (stream.status() != QDataStream::Ok || magic != CacheMagic || storedDirPath != dirPath || count < 0) return output;
+
+	output.reserve(count);
+	for (int i = 0; i < count; i++) {
+		QString fileName;
+		ImageHash hash;
+		stream >> fileName >> hash.valid >> hash.dHash >> hash.pHash >> hash.size >> hash.lastModified;
+		if (stream.status() != QDataStream::Ok) return ImageHashHash();
+		output.insert(fileName, hash);
+	}
+
+	return output;
+}
+
+bool DuplicateFinder::saveCache(const QString& dirPath, const ImageHashHash& hashes) {
+	QString filePath = cachePath(dirPath);
+	QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+	QSaveFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly)) return false;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream << CacheMagic << dirPath << (qint32)hashes.size();
+
+	for (ImageHashHash::const_iterator it = hashes.constBegin(); it != hashes.constEnd(); ++it) {
+		const ImageHash& hash = it.value();
+		stream << it.key() << hash.valid << hash.dHash << hash.pHash << hash.size << hash.lastModified;
+	}
+
+	return file.commit();
+}
+
+void DuplicateFinder::findTask_progress(int requestId, int doneCount, int totalCount) {
+	if (requestId != requestId_ || !running_) return;
+	emit progress(doneCount, totalCount);
+}
+
+void DuplicateFinder::findTask_done(int requestId, const mv::DuplicateGroups& groups) {
+	if (requestId != requestId_ || !running_) return;
+	running_ = false;
+	emit found(groups);
+}
+
+}
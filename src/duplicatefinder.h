@@ -0,0 +1,125 @@
+#ifndef MV_DUPLICATEFINDER_H
+#define MV_DUPLICATEFINDER_H
+
+namespace mv {
+
+// Perceptual hashes of an image, which are close (in Hamming distance) for
+// images that look alike, even if they have been resized, recompressed or
+// slightly edited.
+struct ImageHash {
+	ImageHash();
+	bool valid;
+	// Whether each pixel of a 9x8 grayscale thumbnail is brighter than its
+	// right neighbour. Sensitive to the overall structure of the image.
+	quint64 dHash;
+	// Whether each of the 8x8 lowest frequencies of the DCT of a 32x32
+	// grayscale thumbnail is above their median. More robust to changes of
+	// brightness and contrast.
+	quint64 pHash;
+	// Of the file the hashes were computed from
+	qint64 size;
+	qint64 lastModified;
+};
+
+typedef QHash<QString, ImageHash> ImageHashHash;
+// Qt declares the meta type of lists of registered types itself
+typedef QList<QStringList> DuplicateGroups;
+
+// Computes the hashes of a few files, into the given array. Files are given
+// their own tasks in small chunks so that all the threads of the pool are
+// kept busy until the end.
+class ImageHashTask : public QRunnable {
+
+public:
+
+	ImageHashTask(const QStringList& filePaths, ImageHash* output, QAtomicInt* doneCount, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	QStringList filePaths_;
+	ImageHash* output_;
+	QAtomicInt* doneCount_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+class DuplicateFinder;
+
+// Loads the cached hashes of the directory, has the missing ones computed
+// by the hash pool, then groups the files and saves the hashes back to the
+// cache.
+class DuplicateFindTask : public QRunnable {
+
+public:
+
+	DuplicateFindTask(DuplicateFinder* finder, QThreadPool* hashThreadPool, const QString& dirPath, const QStringList& fileNames, int threshold, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	DuplicateFinder* finder_;
+	QThreadPool* hashThreadPool_;
+	QString dirPath_;
+	QStringList fileNames_;
+	int threshold_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Finds the groups of duplicates and near-duplicates (eg. burst shots) of a
+// directory. Hashes are computed on a thread pool from scaled-down decodes,
+// which the JPEG decoder does at a fraction of the cost of a full decode.
+// They are saved to the cache folder like the metadata index, and reused as
+// long as the size and modification time of the files don't change.
+//
+// Two images are duplicates if both their hashes are within the threshold.
+// Candidates are found with multi-index hashing on the pHash, which only
+// looks up the hashes that share part of their bits with the searched one,
+// so that directories of 100k images don't need to compare every pair. Groups are the connected sets of
+// duplicates, in the order of the given files.
+class DuplicateFinder : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	DuplicateFinder(QObject* parent = 0);
+	~DuplicateFinder();
+	void find(const QString& dirPath, const QStringList& fileNames, int threshold);
+	void cancel();
+	bool isRunning() const;
+	static ImageHash computeHash(const QString& filePath);
+	static ImageHash computeHash(const QImage& image);
+	static int distance(quint64 hash1, quint64 hash2);
+	static DuplicateGroups group(const QStringList& fileNames, const std::vector<ImageHash>& hashes, int threshold);
+	static QString cachePath(const QString& dirPath);
+	static ImageHashHash loadCache(const QString& dirPath);
+	static bool saveCache(const QString& dirPath, const ImageHashHash& hashes);
+
+private:
+
+	int requestId_;
+	bool running_;
+	QSharedPointer<QAtomicInt> canceled_;
+	// The find task only coordinates and waits for the hash pool, so it has
+	// its own thread.
+	QThreadPool findThreadPool_;
+	QThreadPool hashThreadPool_;
+
+public slots:
+
+	void findTask_progress(int requestId, int doneCount, int totalCount);
+	void findTask_done(int requestId, const mv::DuplicateGroups& groups);
+
+signals:
+
+	void progress(int doneCount, int totalCount);
+	void found(const mv::DuplicateGroups& groups);
+
+};
+
+}
+
+#endif // MV_DUPLICATEFINDER_H
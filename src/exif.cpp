@@ -15,16 +15,22 @@ Exif::~Exif() {
 }
 
 void Exif::loadFile(const QString& filePath) {
-	const char *cfilePath = filePath.toStdString().c_str();
+	QByteArray encodedFilePath = QFile::encodeName(filePath);
+	const char *cfilePath = encodedFilePath.constData();
 
 	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(cfilePath, 0);
 	if (fif == FIF_UNKNOWN) fif = FreeImage_GetFIFFromFilename(cfilePath);
 
-	if ((fif != FIF_UNKNOWN) && FreeImage_FIFSupportsReading(fif)) {
-		dib_ = FreeImage_Load(fif, cfilePath, FIF_LOAD_NOPIXELS);
-	} else {
+	if ((fif == FIF_UNKNOWN) || !FreeImage_FIFSupportsReading(fif)) {
 		qWarning() << "Format not supported:" << filePath;
+		return;
 	}
+
+	// Plugins that cannot skip the pixels would decode the whole image,
+	// which is far too slow just to read the metadata.
+	if (!FreeImage_FIFSupportsNoPixels(fif)) return;
+
+	dib_ = FreeImage_Load(fif, cfilePath, FIF_LOAD_NOPIXELS);
 }
 
 int Exif::orientation() const {
@@ -46,6 +52,59 @@ int Exif::orientation() const {
 	return *v;
 }
 
+// Size of the image as specified in its header
+QSize Exif::size() const {
+	if (!dib_) return QSize();
+	int width = FreeImage_GetWidth(dib_);
+	int height = FreeImage_GetHeight(dib_);
+	if (width <= 0 || height <= 0) return QSize();
+	return QSize(width, height);
+}
+
+// Time the picture was taken, or the time the file was last changed by the
+// camera or an editor if that's not available. Returns an invalid date time
+// if the file has neither. EXIF times have no time zone, so they are taken
+// as local time.
+QDateTime Exif::dateTime() const {
+	if (!dib_) return QDateTime();
+
+	FITAG *tag = NULL;
+	FreeImage_GetMetadata(FIMD_EXIF_EXIF, dib_, "DateTimeOriginal", &tag);
+	if (!tag) FreeImage_GetMetadata(FIMD_EXIF_MAIN, dib_, "DateTime", &tag);
+	if (!tag) return QDateTime();
+
+	const char* v = (const char*)FreeImage_GetTagValue(tag);
+	if (!v) return QDateTime();
+
+	return QDateTime::fromString(QString::fromLatin1(v).trimmed(), "yyyy:MM:dd HH:mm:ss");
+}
+
+// Returns the preview embedded in the file, if any (usually the EXIF
+// thumbnail for JPEG files).
+QImage Exif::thumbnail() const {
+	if (!dib_) return QImage();
+
+	FIBITMAP* thumbnail = FreeImage_GetThumbnail(dib_);
+	if (!thumbnail) return QImage();
+
+	FIBITMAP* thumbnail32 = FreeImage_ConvertTo32Bits(thumbnail);
+	if (!thumbnail32) return QImage();
+
+	int width = FreeImage_GetWidth(thumbnail32);
+	int height = FreeImage_GetHeight(thumbnail32);
+	QImage output(width, height, QImage::Format_ARGB32);
+
+	// FreeImage scanlines are stored bottom-up, in BGRA order on little
+	// endian machines, which is the same layout as QImage::Format_ARGB32.
+	for (int y = 0; y < height; y++) {
+		memcpy(output.scanLine(height - 1 - y), FreeImage_GetScanLine(thumbnail32, y), width * 4);
+	}
+
+	FreeImage_Unload(thumbnail32);
+
+	return output;
+}
+
 int Exif::rotation() const {
 	int o = orientation();
 	if (o == 1 || o == 2) return 0;
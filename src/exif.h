@@ -12,6 +12,9 @@ public:
 	void loadFile(const QString& filePath);
 	int orientation() const;
 	int rotation() const;
+	QSize size() const;
+	QDateTime dateTime() const;
+	QImage thumbnail() const;
 
 private:
 
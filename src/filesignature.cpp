@@ -0,0 +1,70 @@
+#include "filesignature.h"
+
+namespace mv {
+
+FileSignature::FileSignature() {
+	size_ = -1;
+	lastModified_ = -1;
+}
+
+FileSignature FileSignature::fromFile(const QString& filePath) {
+	FileSignature output;
+
+	QFile file(filePath);
+	if (!file.open(QIODevice::ReadOnly)) return output;
+
+	const qint64 chunkSize = 16 * 1024;
+
+	output.size_ = file.size();
+	output.lastModified_ = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(file.read(chunkSize));
+	if (output.size_ > chunkSize) {
+		file.seek(qMax(chunkSize, output.size_ - chunkSize));
+		hash.addData(file.read(chunkSize));
+	}
+	output.hash_ = hash.result();
+
+	return output;
+}
+
+bool FileSignature::isNull() const {
+	return size_ < 0;
+}
+
+// The size and modification time are compared first, so that the file is
+// only read if they both match.
+bool FileSignature::matchesFile(const QString& filePath) const {
+	if (isNull()) return false;
+
+	QFileInfo fileInfo(filePath);
+	if (!fileInfo.exists()) return false;
+	if (fileInfo.size() != size_ || fileInfo.lastModified().toMSecsSinceEpoch() != lastModified_) return false;
+
+	return fromFile(filePath) == *this;
+}
+
+// The hash catches changes that the modification time might miss, for
+// example when a file is rewritten several times within the same second.
+bool FileSignature::operator==(const FileSignature& other) const {
+	return size_ == other.size_ && lastModified_ == other.lastModified_ && hash_ == other.hash_;
+}
+
+bool FileSignature::operator!=(const FileSignature& other) const {
+	return !(*this == other);
+}
+
+FileChangeTask::FileChangeTask(QObject* receiver, const QString& filePath, const FileSignature& signature, int requestId) {
+	receiver_ = receiver;
+	filePath_ = filePath;
+	signature_ = signature;
+	requestId_ = requestId;
+}
+
+void FileChangeTask::run() {
+	bool changed = !signature_.matchesFile(filePath_);
+	QMetaObject::invokeMethod(receiver_, "fileChangeTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(bool, changed), Q_ARG(int, requestId_));
+}
+
+}
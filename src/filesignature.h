@@ -0,0 +1,51 @@
+#ifndef MV_FILESIGNATURE_H
+#define MV_FILESIGNATURE_H
+
+namespace mv {
+
+// Cheap fingerprint of a file, used to tell whether its content has actually
+// changed. It is made of the size, the modification time and a hash of the
+// beginning and end of the file, so computing it doesn't require reading
+// the whole file.
+class FileSignature {
+
+public:
+
+	FileSignature();
+	static FileSignature fromFile(const QString& filePath);
+	bool isNull() const;
+	bool matchesFile(const QString& filePath) const;
+	bool operator==(const FileSignature& other) const;
+	bool operator!=(const FileSignature& other) const;
+
+private:
+
+	qint64 size_;
+	qint64 lastModified_;
+	QByteArray hash_;
+
+};
+
+// Checks on a worker thread whether a file still matches its signature,
+// and posts the result to the receiver's fileChangeTask_done() slot.
+class FileChangeTask : public QRunnable {
+
+public:
+
+	FileChangeTask(QObject* receiver, const QString& filePath, const FileSignature& signature, int requestId);
+	void run();
+
+private:
+
+	QObject* receiver_;
+	QString filePath_;
+	FileSignature signature_;
+	int requestId_;
+
+};
+
+}
+
+Q_DECLARE_METATYPE(mv::FileSignature)
+
+#endif // MV_FILESIGNATURE_H
@@ -0,0 +1,137 @@
+#include "imagecache.h"
+
+namespace mv {
+
+ImageCache::ImageCache(qint64 maxBytes) {
+	maxBytes_ = maxBytes;
+	totalBytes_ = 0;
+	hits_ = 0;
+	misses_ = 0;
+	evictions_ = 0;
+}
+
+void ImageCache::setMaxBytes(qint64 v) {
+	if (maxBytes_ == v) return;
+	maxBytes_ = v;
+	trim();
+}
+
+qint64 ImageCache::maxBytes() const {
+	return maxBytes_;
+}
+
+qint64 ImageCache::totalBytes() const {
+	return totalBytes_;
+}
+
+int ImageCache::count() const {
+	return entries_.size();
+}
+
+bool ImageCache::contains(const QString& key) const {
+	return entries_.contains(key);
+}
+
+// The returned pointer is only valid until the next call to insert(),
+// remove() or clear().
+QPixmap* ImageCache::object(const QString& key) {
+	QHash<QString, Entry>::iterator it = entries_.find(key);
+	if (it == entries_.end()) {
+		misses_++;
+		return NULL;
+	}
+
+	hits_++;
+	lru_.splice(lru_.begin(), lru_, it->lruIterator);
+	return &(it->pixmap);
+}
+
+// Same as object() but doesn't update the usage statistics
+const QPixmap* ImageCache::peek(const QString& key) const {
+	QHash<QString, Entry>::const_iterator it = entries_.find(key);
+	if (it == entries_.end()) return NULL;
+	return &(it->pixmap);
+}
+
+QSize ImageCache::sourceSize(const QString& key) const {
+	QHash<QString, Entry>::const_iterator it = entries_.find(key);
+	if (it == entries_.end()) return QSize();
+	return it->sourceSize;
+}
+
+// Marks the image as recently used without counting it as a hit
+void ImageCache::touch(const QString& key) {
+	QHash<QString, Entry>::iterator it = entries_.find(key);
+	if (it == entries_.end()) return;
+	lru_.splice(lru_.begin(), lru_, it->lruIterator);
+}
+
+void ImageCache::insert(const QString& key, const QPixmap& pixmap, const QSize& sourceSize) {
+	remove(key);
+
+	lru_.push_front(key);
+
+	Entry entry;
+	entry.pixmap = pixmap;
+	entry.sourceSize = sourceSize.isValid() ? sourceSize : pixmap.size();
+	entry.cost = pixmapBytes(pixmap);
+	entry.lruIterator = lru_.begin();
+	entries_.insert(key, entry);
+	totalBytes_ += entry.cost;
+
+	trim();
+}
+
+bool ImageCache::remove(const QString& key) {
+	QHash<QString, Entry>::iterator it = entries_.find(key);
+	if (it == entries_.end()) return false;
+
+	totalBytes_ -= it->cost;
+	lru_.erase(it->lruIterator);
+	entries_.erase(it);
+	return true;
+}
+
+void ImageCache::clear() {
+	entries_.clear();
+	lru_.clear();
+	totalBytes_ = 0;
+}
+
+qint64 ImageCache::hits() const {
+	return hits_;
+}
+
+qint64 ImageCache::misses() const {
+	return misses_;
+}
+
+qint64 ImageCache::evictions() const {
+	return evictions_;
+}
+
+// Number of images of the average size of the cached ones that would fit
+// in the budget, or -1 if the cache is empty.
+int ImageCache::estimatedCapacity() const {
+	if (!totalBytes_) return -1;
+	qint64 averageBytes = totalBytes_ / entries_.size();
+	return (int)qMin(maxBytes_ / averageBytes, (qint64)INT_MAX);
+}
+
+qint64 ImageCache::pixmapBytes(const QPixmap& pixmap) {
+	if (pixmap.isNull()) return 0;
+	int depth = pixmap.depth() < 8 ? 8 : pixmap.depth();
+	return (qint64)pixmap.width() * (qint64)pixmap.height() * (qint64)(depth / 8);
+}
+
+void ImageCache::trim() {
+	// The most recently used image is always kept, even if it is larger than
+	// the budget on its own, otherwise it couldn't be displayed.
+	while (totalBytes_ > maxBytes_ && lru_.size() > 1) {
+		QString key = lru_.back();
+		remove(key);
+		evictions_++;
+	}
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef MV_IMAGECACHE_H
+#define MV_IMAGECACHE_H
+
+namespace mv {
+
+// LRU cache of decoded images whose cost is the size in bytes of each pixmap,
+// so that the number of images it holds depends on their resolution rather
+// than on a fixed count. Since images might be decoded at a reduced
+// resolution, the size of the original image is stored along with each
+// pixmap.
+class ImageCache {
+
+public:
+
+	ImageCache(qint64 maxBytes = 0);
+	void setMaxBytes(qint64 v);
+	qint64 maxBytes() const;
+	qint64 totalBytes() const;
+	int count() const;
+	bool contains(const QString& key) const;
+	QPixmap* object(const QString& key);
+	const QPixmap* peek(const QString& key) const;
+	QSize sourceSize(const QString& key) const;
+	void touch(const QString& key);
+	void insert(const QString& key, const QPixmap& pixmap, const QSize& sourceSize = QSize());
+	bool remove(const QString& key);
+	void clear();
+	qint64 hits() const;
+	qint64 misses() const;
+	qint64 evictions() const;
+	int estimatedCapacity() const;
+	static qint64 pixmapBytes(const QPixmap& pixmap);
+
+private:
+
+	struct Entry {
+		QPixmap pixmap;
+		QSize sourceSize;
+		qint64 cost;
+		std::list<QString>::iterator lruIterator;
+	};
+
+	void trim();
+
+	QHash<QString, Entry> entries_;
+	std::list<QString> lru_; // Most recently used first
+	qint64 maxBytes_;
+	qint64 totalBytes_;
+	qint64 hits_;
+	qint64 misses_;
+	qint64 evictions_;
+
+};
+
+}
+
+#endif // MV_IMAGECACHE_H
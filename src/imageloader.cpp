@@ -0,0 +1,260 @@
+#include "exif.h"
+#include "imageloader.h"
+#include "performancelog.h"
+#include "thumbnailcache.h"
+#include "ziparchive.h"
+
+namespace mv {
+
+CancelableFile::CancelableFile(const QString& filePath, QSharedPointer<QAtomicInt> canceled) : QFile(filePath) {
+	canceled_ = canceled;
+	readTime_ = 0;
+}
+
+qint64 CancelableFile::readData(char* data, qint64 maxSize) {
+	if (canceled_->load()) return -1;
+	QElapsedTimer timer;
+	timer.start();
+	qint64 output = QFile::readData(data, maxSize);
+	readTime_ += timer.nsecsElapsed() / 1000;
+	return output;
+}
+
+// Total time spent reading the file, in microseconds
+qint64 CancelableFile::readTime() const {
+	return readTime_;
+}
+
+DecodeTask::DecodeTask(ImageLoader* loader, const QString& filePath, const QSize& maxSize, bool saveThumbnails, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	loader_ = loader;
+	filePath_ = filePath;
+	maxSize_ = maxSize;
+	saveThumbnails_ = saveThumbnails;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void DecodeTask::run() {
+	// The request might have been canceled while it was waiting in the queue
+	if (canceled_->load()) return;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	// Files in archives are decompressed into memory first. Only that entry
+	// is read from the archive.
+	bool inArchive = ZipArchive::isArchiveEntry(filePath_);
+
+	// Read before the image, so that changes made while it's being decoded
+	// don't match. Files in archives are watched through the archive.
+	FileSignature signature;
+	if (!inArchive) signature = FileSignature::fromFile(filePath_);
+	CancelableFile file(filePath_, canceled_);
+	QBuffer buffer;
+	QIODevice* device = &file;
+	qint64 readTime = 0;
+
+	if (inArchive) {
+		QString error;
+		QByteArray data = ZipArchive::readFile(filePath_, &error);
+		if (error != "") {
+			qWarning() << "Could not read" << filePath_ << ":" << error;
+			postFailure();
+			return;
+		}
+		if (canceled_->load()) return;
+		readTime = timer.nsecsElapsed() / 1000;
+		buffer.setData(data);
+		buffer.open(QIODevice::ReadOnly);
+		device = &buffer;
+	} else if (!file.open(QIODevice::ReadOnly)) {
+		qWarning() << "Could not open" << filePath_ << ":" << file.errorString();
+		postFailure();
+		return;
+	}
+
+	// The suffix is only a hint, the format is still detected from the
+	// content if it doesn't match.
+	QImageReader reader(device, QFileInfo(filePath_).suffix().toLower().toLatin1());
+	QSize sourceSize = reader.size();
+
+	if (maxSize_.isValid() && sourceSize.isValid()) {
+		if (sourceSize.width() > maxSize_.width() || sourceSize.height() > maxSize_.height()) {
+			reader.setScaledSize(sourceSize.scaled(maxSize_, Qt::KeepAspectRatio));
+		}
+	}
+
+	// Only checks the format, so this is also true for single frame GIFs.
+	// The animation player can't read files in archives.
+	bool animated = !inArchive && reader.supportsAnimation();
+
+	QImage image = reader.read();
+	if (canceled_->load()) return;
+
+	if (image.isNull()) qWarning() << "Could not decode" << filePath_ << ":" << reader.errorString();
+	if (!sourceSize.isValid()) sourceSize = image.size();
+
+	qint64 totalTime = timer.nsecsElapsed() / 1000;
+	if (!inArchive) readTime = file.readTime();
+	performanceLog::record("io", filePath_, readTime);
+	performanceLog::record("decode", filePath_, totalTime - readTime);
+
+	// The loader lives in the GUI thread so the result must be queued
+	QMetaObject::invokeMethod(loader_, "decodeTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(QImage, image), Q_ARG(QSize, sourceSize), Q_ARG(bool, animated), Q_ARG(mv::FileSignature, signature), Q_ARG(int, requestId_));
+
+	// Done after the image has been posted so as not to delay its display.
+	// Thumbnails are not cached for files in archives.
+	if (saveThumbnails_ && !inArchive) thumbnailCache::save(filePath_, image, sourceSize);
+}
+
+// Posts a null image, so that the request is done and the file can be
+// loaded again (eg. once it's no longer locked by the program writing it).
+void DecodeTask::postFailure() {
+	QMetaObject::invokeMethod(loader_, "decodeTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(QImage, QImage()), Q_ARG(QSize, QSize()), Q_ARG(bool, false), Q_ARG(mv::FileSignature, FileSignature()), Q_ARG(int, requestId_));
+}
+
+PreviewTask::PreviewTask(ImageLoader* loader, const QString& filePath, bool useThumbnailCache, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	loader_ = loader;
+	filePath_ = filePath;
+	useThumbnailCache_ = useThumbnailCache;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void PreviewTask::run() {
+	if (canceled_->load()) return;
+
+	QSize sourceSize;
+	QImage image;
+
+	// There are no previews for files in archives, which are only read by
+	// the decoder. A null image is still posted so that the request is done.
+	if (ZipArchive::isArchiveEntry(filePath_)) {
+		QMetaObject::invokeMethod(loader_, "previewTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(QImage, image), Q_ARG(QSize, sourceSize), Q_ARG(int, requestId_));
+		return;
+	}
+
+	if (useThumbnailCache_) image = thumbnailCache::load(filePath_, &sourceSize);
+
+	if (image.isNull() || !sourceSize.isValid()) {
+		// Only the header and metadata are read, not the pixels
+		Exif exif(filePath_);
+		if (image.isNull()) image = exif.thumbnail();
+		sourceSize = exif.size();
+	}
+
+	if (canceled_->load()) return;
+
+	QMetaObject::invokeMethod(loader_, "previewTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(QImage, image), Q_ARG(QSize, sourceSize), Q_ARG(int, requestId_));
+}
+
+ImageLoader::ImageLoader(QObject* parent) : QObject(parent) {
+	qRegisterMetaType<mv::FileSignature>("mv::FileSignature");
+
+	nextRequestId_ = 1;
+	thumbnailCacheEnabled_ = false;
+	// Leave one core to the GUI thread so that it stays responsive.
+	threadPool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+	previewThreadPool_.setMaxThreadCount(1);
+}
+
+ImageLoader::~ImageLoader() {
+	clear();
+	threadPool_.waitForDone();
+	previewThreadPool_.waitForDone();
+}
+
+void ImageLoader::load(const QString& filePath, int priority, const QSize& maxSize) {
+	if (filePath == "") return;
+
+	QSize size = maxSize;
+
+	if (requests_.contains(filePath)) {
+		// If the image is already queued with a lower priority (eg. it was
+		// being preloaded and is now being displayed) or at a lower
+		// resolution, requeue it with the highest of both.
+		Request previous = requests_[filePath];
+		bool higherPriority = priority > previous.priority;
+		bool higherResolution = previous.maxSize.isValid() && (!size.isValid() || size.width() > previous.maxSize.width() || size.height() > previous.maxSize.height());
+		if (!higherPriority && !higherResolution) return;
+		if (!higherPriority) priority = previous.priority;
+		if (!higherResolution) size = previous.maxSize;
+		cancel(filePath);
+	}
+
+	Request request;
+	request.id = nextRequestId_++;
+	request.priority = priority;
+	request.maxSize = size;
+	request.canceled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	requests_.insert(filePath, request);
+
+	threadPool_.start(new DecodeTask(this, filePath, size, thumbnailCacheEnabled_, request.id, request.canceled), priority);
+}
+
+bool ImageLoader::isLoading(const QString& filePath) const {
+	return requests_.contains(filePath);
+}
+
+// Canceled requests that are still queued finish immediately. Those that
+// are already being decoded are aborted at the decoder's next read.
+void ImageLoader::cancel(const QString& filePath) {
+	if (!requests_.contains(filePath)) return;
+	requests_[filePath].canceled->store(1);
+	requests_.remove(filePath);
+}
+
+void ImageLoader::cancelAllExcept(const QStringList& filePaths) {
+	QStringList toCancel;
+	for (QHash<QString, Request>::const_iterator it = requests_.begin(); it != requests_.end(); ++it) {
+		if (!filePaths.contains(it.key())) toCancel << it.key();
+	}
+
+	for (int i = 0; i < toCancel.size(); i++) cancel(toCancel[i]);
+}
+
+void ImageLoader::loadPreview(const QString& filePath) {
+	if (filePath == "" || previewRequests_.contains(filePath)) return;
+
+	cancelPreviews();
+
+	Request request;
+	request.id = nextRequestId_++;
+	request.priority = 0;
+	request.canceled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	previewRequests_.insert(filePath, request);
+
+	previewThreadPool_.start(new PreviewTask(this, filePath, thumbnailCacheEnabled_, request.id, request.canceled));
+}
+
+void ImageLoader::setThumbnailCacheEnabled(bool v) {
+	thumbnailCacheEnabled_ = v;
+}
+
+void ImageLoader::cancelPreviews() {
+	for (QHash<QString, Request>::iterator it = previewRequests_.begin(); it != previewRequests_.end(); ++it) {
+		it->canceled->store(1);
+	}
+	previewRequests_.clear();
+}
+
+void ImageLoader::clear() {
+	cancelAllExcept(QStringList());
+	cancelPreviews();
+}
+
+void ImageLoader::decodeTask_done(const QString& filePath, const QImage& image, const QSize& sourceSize, bool animated, const mv::FileSignature& signature, int requestId) {
+	if (!requests_.contains(filePath) || requests_[filePath].id != requestId) return;
+	requests_.remove(filePath);
+	emit imageLoaded(filePath, image, sourceSize, animated, signature);
+}
+
+void ImageLoader::previewTask_done(const QString& filePath, const QImage& image, const QSize& sourceSize, int requestId) {
+	if (!previewRequests_.contains(filePath) || previewRequests_[filePath].id != requestId) return;
+	previewRequests_.remove(filePath);
+	// The file has no preview
+	if (image.isNull()) return;
+	emit previewLoaded(filePath, image, sourceSize);
+}
+
+}
@@ -0,0 +1,138 @@
+#ifndef MV_IMAGELOADER_H
+#define MV_IMAGELOADER_H
+
+#include "filesignature.h"
+
+namespace mv {
+
+class ImageLoader;
+
+// File whose reads fail as soon as the request it belongs to is canceled, so
+// that a decoder working on an image that is no longer needed gives up at its
+// next read instead of decoding the whole file.
+class CancelableFile : public QFile {
+
+public:
+
+	CancelableFile(const QString& filePath, QSharedPointer<QAtomicInt> canceled);
+	qint64 readTime() const;
+
+protected:
+
+	qint64 readData(char* data, qint64 maxSize);
+
+private:
+
+	QSharedPointer<QAtomicInt> canceled_;
+	qint64 readTime_;
+
+};
+
+class DecodeTask : public QRunnable {
+
+public:
+
+	DecodeTask(ImageLoader* loader, const QString& filePath, const QSize& maxSize, bool saveThumbnails, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	void postFailure();
+
+	ImageLoader* loader_;
+	QString filePath_;
+	QSize maxSize_;
+	bool saveThumbnails_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+class PreviewTask : public QRunnable {
+
+public:
+
+	PreviewTask(ImageLoader* loader, const QString& filePath, bool useThumbnailCache, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	ImageLoader* loader_;
+	QString filePath_;
+	bool useThumbnailCache_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Decodes images into QImages on a pool of worker threads. Results are
+// posted back to the thread that owns the loader (normally the GUI thread)
+// through the imageLoaded() signal, where they can be turned into QPixmaps.
+//
+// If a maximum size is given, images larger than it are decoded at a reduced
+// resolution, which for JPEG is done directly by the decoder (DCT scaling)
+// and is therefore much faster than a full decode. An invalid size means
+// full resolution.
+//
+// Previews are read on a separate thread so that they are never queued
+// behind full decodes. Only the latest preview request is kept since
+// previews are only useful for the displayed image. They come from the
+// persistent thumbnail cache if enabled, or from the preview embedded in the
+// file (eg. EXIF thumbnail). Decoded images are in turn used to fill the
+// thumbnail cache.
+//
+// Images in a format that supports animation are flagged as such, so that
+// the file doesn't need to be opened again to know whether to play it.
+// Decoded images also come with the signature of their file as it was
+// before being read, to later tell whether the file has actually changed.
+class ImageLoader : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	static const int PreloadPriority = 0;
+	static const int DisplayPriority = 10;
+
+	ImageLoader(QObject* parent = 0);
+	~ImageLoader();
+	void load(const QString& filePath, int priority = PreloadPriority, const QSize& maxSize = QSize());
+	bool isLoading(const QString& filePath) const;
+	void cancel(const QString& filePath);
+	void cancelAllExcept(const QStringList& filePaths);
+	void loadPreview(const QString& filePath);
+	void setThumbnailCacheEnabled(bool v);
+	void clear();
+
+private:
+
+	struct Request {
+		int id;
+		int priority;
+		QSize maxSize;
+		QSharedPointer<QAtomicInt> canceled;
+	};
+
+	QThreadPool threadPool_;
+	QThreadPool previewThreadPool_;
+	QHash<QString, Request> requests_;
+	QHash<QString, Request> previewRequests_;
+	int nextRequestId_;
+	bool thumbnailCacheEnabled_;
+	void cancelPreviews();
+
+public slots:
+
+	void decodeTask_done(const QString& filePath, const QImage& image, const QSize& sourceSize, bool animated, const mv::FileSignature& signature, int requestId);
+	void previewTask_done(const QString& filePath, const QImage& image, const QSize& sourceSize, int requestId);
+
+signals:
+
+	void imageLoaded(const QString& filePath, const QImage& image, const QSize& sourceSize, bool animated, const mv::FileSignature& signature);
+	void previewLoaded(const QString& filePath, const QImage& image, const QSize& sourceSize);
+
+};
+
+}
+
+#endif // MV_IMAGELOADER_H
@@ -5,13 +5,22 @@ namespace jsapi {
 
 Application::Application(QScriptEngine* engine) {
 	engine_ = engine;
+	undoEnabled_ = true;
+}
+
+// Undo only applies to the current image, so it's disabled for batch runs,
+// which also run in parallel.
+void Application::setUndoEnabled(bool enabled) {
+	undoEnabled_ = enabled;
 }
 
 void Application::pushUndoState() {
+	if (!undoEnabled_) return;
 	mv::Application::instance()->pushUndoState();
 }
 
 void Application::popUndoState() {
+	if (!undoEnabled_) return;
 	mv::Application::instance()->popUndoState();
 }
 
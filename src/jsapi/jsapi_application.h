@@ -10,6 +10,7 @@ class Application : public QObject {
 public:
 
 	Application(QScriptEngine* engine);
+	void setUndoEnabled(bool enabled);
 
 public slots:
 
@@ -20,6 +21,7 @@ public slots:
 private:
 
 	QScriptEngine* engine_;
+	bool undoEnabled_;
 
 };
 
@@ -238,11 +238,39 @@ void FormDialog::lineEdit_textEdited(const QString& text) {
 	// e->triggerEvent("onChange");
 }
 
+// Answers are either false, if the form was canceled, or a map of the
+// values of the form elements
+bool FormAnswers::answer(const QString& title, QVariant* output) const {
+	QMutexLocker locker(&mutex_);
+	QHash<QString, QVariant>::const_iterator it = answers_.constFind(title);
+	if (it == answers_.constEnd()) return false;
+	*output = it.value();
+	return true;
+}
+
+void FormAnswers::setAnswer(const QString& title, const QVariant& answer) {
+	QMutexLocker locker(&mutex_);
+	answers_.insert(title, answer);
+}
+
+bool FormAnswers::hasCanceledForm() const {
+	QMutexLocker locker(&mutex_);
+	for (QHash<QString, QVariant>::const_iterator it = answers_.constBegin(); it != answers_.constEnd(); ++it) {
+		if (it.value().type() == QVariant::Bool) return true;
+	}
+	return false;
+}
+
 Ui::Ui(QScriptEngine* engine) {
 	engine_ = engine;
 	formElementRegistered_ = false;
 }
 
+// If set, forms that have already been answered are not shown again
+void Ui::setFormAnswers(QSharedPointer<FormAnswers> formAnswers) {
+	formAnswers_ = formAnswers;
+}
+
 QObject* Ui::newFormElement(const QString& type, const QString& name, const QString& title, const QString& description) {
 	FormElement* e = new FormElement(type, name, title, description);
 	return dynamic_cast<QObject*>(e);
@@ -318,12 +346,27 @@ QScriptValue Ui::form_(const QScriptValue& form, const QString& title) {
 QScriptValue Ui::form(const QScriptValue& form, const QString& title) {
 	QScriptValue output;
 
+	QVariant answer;
+	if (formAnswers_ && formAnswers_->answer(title, &answer)) {
+		if (answer.type() == QVariant::Bool) return QScriptValue(false);
+		output = engine_->newObject();
+		QVariantMap values = answer.toMap();
+		for (QVariantMap::const_iterator it = values.constBegin(); it != values.constEnd(); ++it) {
+			output.setProperty(it.key(), mv::scriptutil::variantToScriptValue(it.value()));
+		}
+		return output;
+	}
+
 	QMetaObject::invokeMethod(this, "form_", Qt::BlockingQueuedConnection,
 		Q_RETURN_ARG(QScriptValue, output),
 		Q_ARG(QScriptValue, form),
 		Q_ARG(QString, title)
 	);
 
+	// A script that asks again (eg. because the values were invalid)
+	// replaces the previous answer
+	if (formAnswers_) formAnswers_->setAnswer(title, output.isBool() ? QVariant(false) : output.toVariant());
+
 	return output;
 }
 
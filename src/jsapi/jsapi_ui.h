@@ -82,6 +82,24 @@ public slots:
 
 };
 
+// Answers given to the forms of a script, by form title. When a script is
+// run once per file in a batch, the forms are only shown by the first run
+// and the answers are given back to the other runs, which can be on other
+// threads.
+class FormAnswers {
+
+public:
+
+	bool answer(const QString& title, QVariant* output) const;
+	void setAnswer(const QString& title, const QVariant& answer);
+	bool hasCanceledForm() const;
+
+private:
+
+	mutable QMutex mutex_;
+	QHash<QString, QVariant> answers_;
+
+};
 
 class Ui : public QObject {
 
@@ -90,6 +108,7 @@ class Ui : public QObject {
 public:
 
 	Ui(QScriptEngine* engine);
+	void setFormAnswers(QSharedPointer<FormAnswers> formAnswers);
 
 public slots:
 
@@ -104,6 +123,7 @@ private:
 
 	QScriptEngine* engine_;
 	bool formElementRegistered_;
+	QSharedPointer<FormAnswers> formAnswers_;
 
 };
 
@@ -3,6 +3,8 @@
 
 #include "application.h"
 #include "messageboxes.h"
+#include "performancelog.h"
+#include "resampler.h"
 #include "settings.h"
 #include "simplefunctions.h"
 
@@ -15,6 +17,13 @@ void XGraphicsView::scrollContentsBy(int x, int y) {
 	QGraphicsView::scrollContentsBy(x, y); // Override scrollContentsBy to disable scrolling
 }
 
+void XGraphicsView::paintEvent(QPaintEvent* event) {
+	QElapsedTimer timer;
+	timer.start();
+	QGraphicsView::paintEvent(event);
+	mv::performanceLog::record("paint", mv::Application::instance()->source(), timer.nsecsElapsed() / 1000);
+}
+
 void XGraphicsView::mousePressEvent(QMouseEvent* event) {
 	QGraphicsView::mousePressEvent(event);
 	clicked_ = true;
@@ -62,13 +71,17 @@ void XGraphicsView::dropEvent(QDropEvent* event) {
 	mv::Application::instance()->setSource(filePath);
 }
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow), pixmapCache_(3) {
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow) {
 	ready_ = false;
-	updateDisplayTimer_ = NULL;
 	loopPixmapItem_ = NULL;
 	hideLoopItemTimer_ = NULL;
 	loopPixmap_ = NULL;
 	pixmap_ = NULL;
+	pixmapIsPreview_ = false;
+	skimming_ = false;
+	drawnPixmapScale_ = 1;
+	renderRequestId_ = 0;
+	mipmapKey_ = 0;
 	rotation_ = 0;
 	invalidated_ = true;
 	selectionInvalidated_ = true;
@@ -115,6 +128,13 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 	pixmapItem_ = new QGraphicsPixmapItem();
 	scene_->addItem(pixmapItem_);
 
+	// Replaces pixmapItem_ when visible, which is then used as a low
+	// resolution placeholder while tiles are being decoded.
+	tiledImageItem_ = new mv::TiledImageItem();
+	tiledImageItem_->setZValue(1);
+	tiledImageItem_->setVisible(false);
+	scene_->addItem(tiledImageItem_);
+
 	selectionRectItem_ = new QGraphicsRectItem();
 	selectionRectItem_->setBrush(QBrush(QColor(255,255,255,25)));
 	selectionRectItem_->setPen(QPen(Qt::black));
@@ -152,6 +172,23 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 	connect(view_, SIGNAL(mouseRelease(QMouseEvent*)), this, SLOT(view_mouseRelease(QMouseEvent*)));
 	connect(view_, SIGNAL(mouseDrag(QMouseEvent*)), this, SLOT(view_mouseDrag(QMouseEvent*)));
 
+	imageLoader_ = new mv::ImageLoader(this);
+	connect(imageLoader_, SIGNAL(imageLoaded(const QString&, const QImage&, const QSize&, bool, const mv::FileSignature&)), this, SLOT(imageLoader_imageLoaded(const QString&, const QImage&, const QSize&, bool, const mv::FileSignature&)));
+	connect(imageLoader_, SIGNAL(previewLoaded(const QString&, const QImage&, const QSize&)), this, SLOT(imageLoader_previewLoaded(const QString&, const QImage&, const QSize&)));
+
+	// A few screen-sized bitmaps is all the display cache needs
+	QSize screenSize = decodeSize();
+	if (screenSize.isValid()) displayCache_.setMaxBytes((qint64)4 * screenSize.width() * screenSize.height() * 4);
+
+	mipmapCache_.setMaxBytes(128 * 1024 * 1024);
+	mipmapThreadPool_.setMaxThreadCount(1);
+	renderThreadPool_.setMaxThreadCount(1);
+
+	animationPlayer_ = new mv::AnimationPlayer(this);
+	connect(animationPlayer_, SIGNAL(frameChanged(const QString&, const QImage&)), this, SLOT(animationPlayer_frameChanged(const QString&, const QImage&)));
+
+	refreshCacheSettings();
+
 	view_->show();
 
 	ready_ = true;
@@ -159,6 +196,10 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 }
 
 MainWindow::~MainWindow() {
+	if (mipmapCanceled_) mipmapCanceled_->store(1);
+	mipmapThreadPool_.waitForDone();
+	if (renderCanceled_) renderCanceled_->store(1);
+	renderThreadPool_.waitForDone();
 	// TODO: delete objects
 	delete ui;
 }
@@ -173,6 +214,10 @@ void MainWindow::onActionStart() {
 		statusBar()->addPermanentWidget(progressBar_);
 	}
 
+	// Busy indicator until progress is known
+	progressBar_->setMaximum(0);
+	progressBar_->setValue(0);
+
 	if (!progressBarCancelButton_) {
 		progressBarCancelButton_ = new QLabel(this);
 		progressBarCancelButton_->setText("<a href=\"#\">" + tr("Cancel") + "</a>");
@@ -223,6 +268,12 @@ void MainWindow::showProgressBarCancelButton(bool doShow) {
 	}
 }
 
+void MainWindow::setProgress(int value, int maximum) {
+	if (!progressBar_) return;
+	progressBar_->setMaximum(maximum);
+	progressBar_->setValue(value);
+}
+
 void MainWindow::clearSelection() {
 	selectionP1_ = QPoint(0,0);
 	selectionP2_ = QPoint(0,0);
@@ -267,15 +318,16 @@ QRect MainWindow::selectionRect() const {
 	if (output.x() < 0) output.setX(0);
 	if (output.y() < 0) output.setY(0);
 	if (pixmap_) {
-		if (output.right() > pixmap_->width()) output.setWidth(pixmap_->width() - output.x());
-		if (output.bottom() > pixmap_->height()) output.setHeight(pixmap_->height() - output.y());
+		if (output.right() > sourceSize_.width()) output.setWidth(sourceSize_.width() - output.x());
+		if (output.bottom() > sourceSize_.height()) output.setHeight(sourceSize_.height() - output.y());
 	}
 	return output;
 }
 
 QPoint MainWindow::mapViewToPixmapItem(const QPoint& point) const {
 	QPointF p = view_->mapToScene(point);
-	QPointF p2 = pixmapItem_->mapFromScene(p);
+	QPointF p2 = pixmapItemTransform_.inverted().map(pixmapItem_->mapFromScene(p));
+	if (!autoFit()) p2 /= drawnPixmapScale_;
 	QPoint output(floor(p2.x()), floor(p2.y()));
 	if (autoFit()) {
 		float z = fitZoom();
@@ -290,14 +342,12 @@ QPoint MainWindow::mapViewToPixmapItem(const QPoint& point) const {
 QRectF MainWindow::mapPixmapItemToView(const QRect& rect) const {
 	if (autoFit()) {
 		float z = fitZoom();
-		QRectF output;
-		output.setX(rect.x() * z + pixmapItem_->x());
-		output.setY(rect.y() * z + pixmapItem_->y());
-		output.setWidth(rect.width() * z);
-		output.setHeight(rect.height() * z);
-		return output;
+		QRectF output(rect.x() * z, rect.y() * z, rect.width() * z, rect.height() * z);
+		return pixmapItemTransform_.mapRect(output).translated(pixmapItem_->pos());
 	}
-	return pixmapItem_->mapToScene(rect).boundingRect();
+	float s = drawnPixmapScale_;
+	QRectF pixmapRect(rect.x() * s, rect.y() * s, rect.width() * s, rect.height() * s);
+	return pixmapItem_->mapToScene(pixmapRect).boundingRect();
 }
 
 void MainWindow::view_mousePress(QMouseEvent* event) {
@@ -356,6 +406,17 @@ mv::ConsoleWidget* MainWindow::console() const {
 	return console_;
 }
 
+mv::ImageCache* MainWindow::imageCache() {
+	return &pixmapCache_;
+}
+
+void MainWindow::refreshCacheSettings() {
+	mv::Settings settings;
+	pixmapCache_.setMaxBytes((qint64)settings.value("imageCacheSize").toInt() * 1024 * 1024);
+	tiledImageItem_->setCacheMaxBytes((qint64)settings.value("tileCacheSize").toInt() * 1024 * 1024);
+	imageLoader_->setThumbnailCacheEnabled(settings.value("useThumbnailCache").toBool());
+}
+
 void MainWindow::setStatusItem(const QString& name, const QString& value) {
 	QLabel* label = NULL;
 
@@ -420,30 +481,15 @@ void MainWindow::invalidateSelection() {
 	update();
 }
 
-QTimer* MainWindow::updateDisplayTimer() const {
-	if (updateDisplayTimer_) return updateDisplayTimer_;
-
-	updateDisplayTimer_ = new QTimer();
-	updateDisplayTimer_->setSingleShot(true);
-	updateDisplayTimer_->setInterval(600);
-	connect(updateDisplayTimer_, SIGNAL(timeout()), this, SLOT(updateDisplayTimer_timeout()));
-	return updateDisplayTimer_;
-}
-
-void MainWindow::updateDisplayTimer_timeout() {
-	updateDisplay(FullRendering);
-}
-
 void MainWindow::showEvent(QShowEvent* event) {
 	if (event->spontaneous()) return;
-	updateDisplay(FullRendering);
+	updateDisplay();
 }
 
+// The high quality bitmap for the new size is rendered in the background
+// while the quickly scaled one is displayed.
 void MainWindow::resizeEvent(QResizeEvent*) {
-	updateDisplay(QuickRendering);
-
-	updateDisplayTimer()->stop();
-	updateDisplayTimer()->start();
+	updateDisplay();
 }
 
 void MainWindow::closeEvent(QCloseEvent*) {
@@ -456,45 +502,275 @@ void MainWindow::keyPressEvent(QKeyEvent* event) {
 
 void MainWindow::clearSourceAndCache() {
 	source_ = "";
-	pixmap_ = NULL;
+	setPixmap(NULL, "");
+	animationPlayer_->stop();
+	imageLoader_->clear();
 	pixmapCache_.clear();
+	displayCache_.clear();
+	mipmapCache_.clear();
+	animatedSources_.clear();
+	sourceSignatures_.clear();
+	tiledImageItem_->setSource("", QSize());
 	invalidate();
 }
 
-// Loads the source in memory but doesn't display it
+// The displayed pixmap is a (cheap, implicitly shared) copy of the cached
+// one so that it remains valid if the cache evicts it.
+void MainWindow::setPixmap(const QPixmap* pixmap, const QString& pixmapSource, const QSize& sourceSize) {
+	if (pixmap_) delete pixmap_;
+	pixmap_ = pixmap ? new QPixmap(*pixmap) : NULL;
+	pixmapSource_ = pixmapSource;
+	pixmapIsPreview_ = false;
+	sourceSize_ = pixmap && sourceSize.isValid() ? sourceSize : (pixmap ? pixmap->size() : QSize());
+}
+
+// Ratio between the size of the pixmap and the size of the source image,
+// which is less than 1 if the image has been decoded at a reduced
+// resolution.
+float MainWindow::pixmapScale() const {
+	if (!pixmap_ || pixmap_->isNull() || sourceSize_.width() <= 0) return 1;
+	return (float)pixmap_->width() / (float)sourceSize_.width();
+}
+
+// Images are decoded at a resolution that allows them to fill the screen
+// whatever their rotation. The full resolution is only loaded on demand,
+// when zooming in past that size.
+QSize MainWindow::decodeSize() const {
+	QRect screenRect = QApplication::desktop()->screenGeometry(this);
+	int side = qMax(screenRect.width(), screenRect.height());
+	if (side <= 0) return QSize();
+	return QSize(side, side);
+}
+
+// Very large images are never decoded at full resolution. Instead, when
+// zooming in, only the visible tiles are decoded by tiledImageItem_.
+bool MainWindow::useTiledRendering() {
+	if (pixmapSource_ != source_ || source_ == "" || pixmapIsPreview_) return false;
+	if (!isVeryLarge()) return false;
+
+	tiledImageItem_->setSource(source_, sourceSize_);
+	return tiledImageItem_->canRenderSource();
+}
+
+bool MainWindow::isVeryLarge() const {
+	mv::Settings settings;
+	qint64 threshold = (qint64)settings.value("tiledRenderingThreshold").toInt() * 1000000;
+	return (qint64)sourceSize_.width() * (qint64)sourceSize_.height() >= threshold;
+}
+
+// When zoomed in, the tiled item also renders images that are not large
+// enough for useTiledRendering(), so that only the visible part of the image
+// is rendered. Tiles are cut from the pixmap if it's at full resolution,
+// or decoded from the file otherwise.
+bool MainWindow::useMagnifiedRendering() {
+	if (pixmapSource_ != source_ || source_ == "" || pixmapIsPreview_) return false;
+	if (animationPlayer_->isPlaying()) return false;
+
+	tiledImageItem_->setSource(source_, sourceSize_);
+	if (pixmapScale() >= 1) tiledImageItem_->setImage(*pixmap_);
+	return tiledImageItem_->canRenderSource();
+}
+
+void MainWindow::loadFullResolutionSource() {
+	if (pixmapSource_ != source_ || source_ == "" || pixmapIsPreview_) return;
+	imageLoader_->load(source_, mv::ImageLoader::DisplayPriority, QSize());
+}
+
+// Loads the source in memory but doesn't display it. Returns the pixmap if
+// it is already in the cache, otherwise queues it for decoding on the image
+// loader and returns NULL.
 QPixmap* MainWindow::loadSource(const QString& sourcePath) {
-	if (pixmapCache_.contains(sourcePath)) {
-		return pixmapCache_[sourcePath];
+	QPixmap* pixmap = pixmapCache_.object(sourcePath);
+	if (pixmap) return pixmap;
+
+	imageLoader_->load(sourcePath, sourcePath == source_ ? mv::ImageLoader::DisplayPriority : mv::ImageLoader::PreloadPriority, decodeSize());
+	return NULL;
+}
+
+// Makes sure that the given images are decoded and in the cache, the first
+// one being the most important. Decodes queued for any other image (except
+// the current one) are canceled since they are no longer needed.
+void MainWindow::prefetchSources(const QStringList& sourcePaths) {
+	QStringList neededPaths = sourcePaths;
+	if (source_ != "") neededPaths << source_;
+	imageLoader_->cancelAllExcept(neededPaths);
+
+	// Mark the images that are already cached as recently used, least
+	// important first, so that they are the last ones to be evicted.
+	for (int i = neededPaths.size() - 1; i >= 0; i--) pixmapCache_.touch(neededPaths[i]);
+
+	for (int i = 0; i < sourcePaths.size(); i++) {
+		if (pixmapCache_.contains(sourcePaths[i])) continue;
+		imageLoader_->load(sourcePaths[i], mv::ImageLoader::PreloadPriority - i, decodeSize());
 	}
+}
 
-	QPixmap* pixmap = new QPixmap();
-	pixmap->load(sourcePath);
-	pixmapCache_.insert(sourcePath, pixmap);
-	return pixmap;
+// While skimming (eg. when an arrow key is auto-repeating), images that
+// are not in the cache are only shown through their preview, since they
+// would be replaced long before being decoded. The full decode happens once
+// skimming stops.
+void MainWindow::setSkimming(bool v) {
+	if (skimming_ == v) return;
+	skimming_ = v;
+	if (skimming_ || source_ == "") return;
+	if (pixmapSource_ != source_ || pixmapIsPreview_) loadSource(source_);
+	startAnimation();
+}
+
+bool MainWindow::skimming() const {
+	return skimming_;
 }
 
 void MainWindow::setSource(const QString& v) {
 	if (source_ == v) return;
+	QString previousSource = source_;
 	setRotation(0);
 	source_ = v;
-	pixmap_ = source_ == "" ? NULL : loadSource(source_);
+
+	// The user has moved past the previous image so there's no point in
+	// finishing its decode.
+	if (skimming_ && previousSource != "") imageLoader_->cancel(previousSource);
+
+	if (source_ == "") {
+		setPixmap(NULL, "");
+	} else {
+		// If the image is not in the cache yet, the previous frame remains
+		// displayed until the embedded preview, if any, or the decoded
+		// image is available.
+		loadTimer_.start();
+		QPixmap* pixmap = skimming_ ? pixmapCache_.object(source_) : loadSource(source_);
+		mv::performanceLog::recordCacheHit(source_, pixmap != NULL);
+		if (pixmap) {
+			setPixmap(pixmap, source_, pixmapCache_.sourceSize(source_));
+			mv::performanceLog::record("load", source_, loadTimer_.nsecsElapsed() / 1000);
+			loadTimer_.invalidate();
+		} else {
+			imageLoader_->loadPreview(source_);
+		}
+	}
+	startAnimation();
 	clearSelection();
 	invalidate();
 }
 
+// The first frame is also decoded and cached like any other image, so that
+// it can be displayed instantly when coming back to the image. The player
+// then takes over. Whether the image can be animated is only known once it
+// has been decoded once.
+void MainWindow::startAnimation() {
+	animationPlayer_->stop();
+	if (skimming_ || source_ == "") return;
+	if (animatedSources_.contains(source_)) animationPlayer_->start(source_);
+}
+
+// Signature of the source file as it was when the displayed image was
+// decoded, which is null if it's not known.
+mv::FileSignature MainWindow::sourceSignature() const {
+	return sourceSignatures_.value(source_);
+}
+
+// Signatures are kept for the images that are cached or displayed, so
+// those of evicted images are dropped from time to time.
+void MainWindow::setSourceSignature(const QString& filePath, const mv::FileSignature& signature) {
+	sourceSignatures_.insert(filePath, signature);
+	if (sourceSignatures_.size() <= pixmapCache_.count() * 2 + 16) return;
+
+	for (QHash<QString, mv::FileSignature>::iterator it = sourceSignatures_.begin(); it != sourceSignatures_.end(); ) {
+		if (it.key() == source_ || pixmapCache_.contains(it.key())) {
+			++it;
+		} else {
+			it = sourceSignatures_.erase(it);
+		}
+	}
+}
+
 void MainWindow::reloadSource() {
-	int previousWidth = 0;
-	int previousHeight = 0;
-	if (pixmap_) {
-		previousWidth = pixmap_->width();
-		previousHeight = pixmap_->height();
+	// A decode that is already running may have read the old content
+	imageLoader_->cancel(source_);
+	pixmapCache_.remove(source_);
+	tiledImageItem_->clear();
+	loadSource(source_);
+	startAnimation();
+}
+
+void MainWindow::imageLoader_imageLoaded(const QString& filePath, const QImage& image, const QSize& sourceSize, bool animated, const mv::FileSignature& signature) {
+	if (animated) {
+		animatedSources_.insert(filePath);
+	} else {
+		animatedSources_.remove(filePath);
 	}
-	pixmapCache_.remove(source());
-	pixmap_ = loadSource(source_);
-	if (!pixmap_ || pixmap_->width() != previousWidth || pixmap_->height() != previousHeight) {
+
+	// Files that couldn't be read or decoded (eg. while they are locked by
+	// the program writing them) are not cached, so that they are loaded
+	// again the next time they are needed. An image that is already cached
+	// is kept.
+	if (image.isNull()) {
+		if (filePath != source_ || pixmapCache_.contains(filePath)) return;
+		QPixmap pixmap;
+		setPixmap(&pixmap, filePath, sourceSize);
 		clearSelection();
+		invalidate();
+		emit sourceLoaded();
+		return;
+	}
+
+	// Don't replace an image that has already been decoded at a higher
+	// resolution (eg. when a full resolution decode finishes before a
+	// scaled one).
+	const QPixmap* cachedPixmap = pixmapCache_.peek(filePath);
+	if (cachedPixmap && !cachedPixmap->isNull() && cachedPixmap->width() > image.width() && pixmapCache_.sourceSize(filePath) == sourceSize) return;
+
+	pixmapCache_.insert(filePath, QPixmap::fromImage(image), sourceSize);
+	const QPixmap* pixmap = pixmapCache_.peek(filePath);
+	setSourceSignature(filePath, signature);
+
+	if (filePath != source_) return;
+
+	// Don't go back to the first frame if the animation is already playing
+	if (animationPlayer_->source() == filePath && pixmapSource_ == filePath && !pixmapIsPreview_) return;
+
+	if (loadTimer_.isValid()) {
+		mv::performanceLog::record("load", filePath, loadTimer_.nsecsElapsed() / 1000);
+		loadTimer_.invalidate();
 	}
+
+	// Keep the selection if the same image has simply been reloaded with
+	// the same dimensions.
+	bool keepSelection = pixmap_ && pixmapSource_ == filePath && sourceSize_ == sourceSize;
+	setPixmap(pixmap, filePath, sourceSize);
+	if (!keepSelection) clearSelection();
+	invalidate();
+
+	emit sourceLoaded();
+
+	if (animated && animationPlayer_->source() != filePath) startAnimation();
+}
+
+// Embedded previews are displayed while the image is being decoded. They
+// are not cached since they would otherwise prevent the actual image from
+// being loaded.
+void MainWindow::imageLoader_previewLoaded(const QString& filePath, const QImage& image, const QSize& sourceSize) {
+	if (filePath != source_ || pixmapSource_ == source_) return;
+
+	QPixmap pixmap = QPixmap::fromImage(image);
+	setPixmap(&pixmap, filePath, sourceSize);
+	pixmapIsPreview_ = true;
+	invalidate();
+
+	emit sourceLoaded();
+}
+
+// Animation frames are displayed directly and never cached, so only the
+// frames that are waiting to be displayed are in memory.
+void MainWindow::animationPlayer_frameChanged(const QString& filePath, const QImage& image) {
+	if (filePath != source_) return;
+
+	bool wasLoaded = pixmapSource_ == source_ && !pixmapIsPreview_;
+	QPixmap pixmap = QPixmap::fromImage(image);
+	setPixmap(&pixmap, filePath, image.size());
 	invalidate();
+
+	if (!wasLoaded) emit sourceLoaded();
 }
 
 QString MainWindow::source() const {
@@ -509,10 +785,20 @@ void MainWindow::setRotation(int v) {
 	invalidate();
 }
 
+// Returns NULL while the current source is still being decoded, even if
+// the previous frame or the embedded preview is being displayed.
 QPixmap* MainWindow::pixmap() const {
+	if (pixmapSource_ != source_ || pixmapIsPreview_) return NULL;
 	return pixmap_;
 }
 
+// Size of the original image, which might be larger than the size of
+// pixmap(). Like pixmap(), it is invalid while the source is loading.
+QSize MainWindow::sourceSize() const {
+	if (pixmapSource_ != source_ || pixmapIsPreview_) return QSize();
+	return sourceSize_;
+}
+
 int MainWindow::rotation() const {
 	return rotation_;
 }
@@ -574,7 +860,10 @@ float MainWindow::zoom() const {
 void MainWindow::paintEvent(QPaintEvent* event) {
 	if (invalidated_) {
 		invalidated_ = false;
-		updateDisplay(FullRendering);
+		QElapsedTimer timer;
+		timer.start();
+		updateDisplay();
+		mv::performanceLog::record("update", source_, timer.nsecsElapsed() / 1000);
 	}
 
 	if (selectionInvalidated_) {
@@ -591,8 +880,8 @@ float MainWindow::fitZoom() const {
 	bool rotated = this->rotated();
 	QSize winSize = viewContainerSize();
 
-	int pixmapWidth = rotated ? pixmap_->height() : pixmap_->width();
-	int pixmapHeight = rotated ? pixmap_->width() : pixmap_->height();
+	int pixmapWidth = rotated ? sourceSize_.height() : sourceSize_.width();
+	int pixmapHeight = rotated ? sourceSize_.width() : sourceSize_.height();
 
 	float rw = (float)winSize.width() / (float)pixmapWidth;
 	float rh = (float)winSize.height() / (float)pixmapHeight;
@@ -600,7 +889,97 @@ float MainWindow::fitZoom() const {
 	return rw < rh ? rw : rh;
 }
 
-void MainWindow::updateDisplay(int renderingType) {
+// Returns the current pixmap scaled to fit the given size and rotated, as
+// displayed in autofit mode. High quality bitmaps are rendered in the
+// background and cached, and a quickly scaled bitmap is returned in the
+// meantime, so that the event loop is never blocked by scaling (eg. while
+// the window is being resized). The view is refreshed with the high quality
+// bitmap as soon as it's ready.
+//
+// The pixmap cache key changes whenever the pixmap is replaced (eg.
+// reloaded or decoded at a higher resolution), so stale entries are never
+// returned.
+QPixmap MainWindow::displayPixmap(const QSize& size) {
+	QString key = QString("%1:%2:%3x%4:%5").arg(pixmapSource_).arg(pixmap_->cacheKey()).arg(size.width()).arg(size.height()).arg(rotation_);
+	QPixmap* cachedPixmap = displayCache_.object(key);
+	if (cachedPixmap) return *cachedPixmap;
+
+	// Animation frames are only displayed once and would be replaced before
+	// a background render is done, so they are scaled right away.
+	if (animationPlayer_->isPlaying()) {
+		QPixmap output = QPixmap::fromImage(mv::resampler::scaled(pixmap_->toImage(), size, Qt::KeepAspectRatio));
+		if (rotation_) output = output.transformed(QTransform().rotate(rotation_));
+		return output;
+	}
+
+	requestDisplayRender(key, size);
+
+	QPixmap output = pixmap_->scaled(size, Qt::KeepAspectRatio, Qt::FastTransformation);
+	if (rotation_) output = output.transformed(QTransform().rotate(rotation_));
+	return output;
+}
+
+// Only the latest render is kept, the previous one is canceled since it's
+// for a size or an image that is no longer displayed.
+void MainWindow::requestDisplayRender(const QString& key, const QSize& size) {
+	if (renderKey_ == key) return;
+
+	if (renderCanceled_) renderCanceled_->store(1);
+	renderCanceled_ = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	renderKey_ = key;
+	renderRequestId_++;
+
+	renderThreadPool_.start(new mv::DisplayRenderTask(this, pixmapSource_, key, pixmap_->toImage(), size, rotation_, renderRequestId_, renderCanceled_));
+}
+
+void MainWindow::displayRenderTask_done(const QString& key, const QImage& image, int requestId) {
+	if (requestId != renderRequestId_) return;
+	renderKey_ = "";
+	displayCache_.insert(key, QPixmap::fromImage(image));
+	invalidate();
+}
+
+// Returns the finest available mip level of the current pixmap that is not
+// finer than `level`, or NULL if there isn't any yet, in which case the mip
+// chain is built in the background. Mip levels are cached by pixmap, so
+// they remain available when going back to a previous image.
+const QPixmap* MainWindow::mipmap(int level) {
+	qint64 key = pixmap_->cacheKey();
+	for (int l = level; l >= 1; l--) {
+		const QPixmap* output = mipmapCache_.object(QString("%1:%2").arg(key).arg(l));
+		if (output) return output;
+	}
+
+	requestMipmaps();
+	return NULL;
+}
+
+// Levels that have been evicted from the cache are built again, unless the
+// chain of the pixmap is already being built.
+void MainWindow::requestMipmaps() {
+	qint64 key = pixmap_->cacheKey();
+	if (mipmapKey_ == key) return;
+
+	// Animation frames change too often for it to be worth it
+	if (animationPlayer_->isPlaying()) return;
+
+	if (mipmapCanceled_) mipmapCanceled_->store(1);
+	mipmapCanceled_ = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	mipmapKey_ = key;
+
+	mipmapThreadPool_.start(new mv::MipmapTask(this, key, pixmap_->toImage(), mipmapCanceled_));
+}
+
+void MainWindow::mipmapTask_done(qint64 key, int level, const QImage& image) {
+	mipmapCache_.insert(QString("%1:%2").arg(key).arg(level), QPixmap::fromImage(image));
+	if (!autoFit_ && pixmap_ && pixmap_->cacheKey() == key) invalidate();
+}
+
+void MainWindow::mipmapTask_finished(qint64 key) {
+	if (mipmapKey_ == key) mipmapKey_ = 0;
+}
+
+void MainWindow::updateDisplay() {
 	if (!ready_) return;
 
 	invalidated_ = false;
@@ -611,10 +990,11 @@ void MainWindow::updateDisplay(int renderingType) {
 
 	if (!pixmap_) {
 		pixmapItem_->setPixmap(QPixmap());
+		tiledImageItem_->setVisible(false);
 	} else {
 		// Calculate scale factor so that the picture fits within the view
-		int pixmapWidth = pixmap_->width();
-		int pixmapHeight = pixmap_->height();
+		int sourceWidth = sourceSize_.width();
+		int sourceHeight = sourceSize_.height();
 
 		// If not autofit, we use the zoom level as it was before zooming
 		// so that if the window is resized the zoom remains constant.
@@ -624,19 +1004,77 @@ void MainWindow::updateDisplay(int renderingType) {
 		// If we're not trying to fit the photo within the view, we apply the user supplied zoom
 		if (!autoFit_) zoom = zoom * this->zoom();
 
-		// If autoFit, we use a nicely scaled pixmap. If not, scaling is done
-		// via QGraphicsItem (no smoothing).
-		QPixmap drawnPixmap = autoFit_ ? pixmap_->scaled(zoom * (float)pixmapWidth, zoom * (float)pixmapHeight, Qt::KeepAspectRatio, renderingType == QuickRendering ? Qt::FastTransformation : Qt::SmoothTransformation) : *pixmap_;
+		// The pixmap might have been decoded at a reduced resolution, in
+		// which case the full resolution is loaded if the view needs more
+		// pixels than the pixmap has.
+		float pixmapScale = this->pixmapScale();
+		bool tiled = false;
+		// Very large images that can't be tiled either (ie. in a format that
+		// can only be decoded whole) remain at the reduced resolution, since
+		// decoding them would take several GB.
+		if (pixmapScale < 1 && zoom > pixmapScale) {
+			tiled = !autoFit_ && useTiledRendering();
+			if (!tiled && !isVeryLarge()) {
+				loadFullResolutionSource();
+			} else if (!tiled && !autoFit_ && veryLargeWarningSource_ != source_) {
+				qWarning() << "Not loading" << source_ << "at full resolution as it is too large and can't be decoded in tiles";
+				veryLargeWarningSource_ = source_;
+			}
+		}
+		if (!tiled && !autoFit_ && zoom >= mv::TiledImageItem::MagnificationThreshold) tiled = useMagnifiedRendering();
+
+		// If autoFit, we use a nicely scaled pixmap, which is also already
+		// rotated. If not, scaling and rotation are done via QGraphicsItem.
+		// When zoomed out, the pixmap is drawn from the mip level closest to
+		// the zoom (without being below it), so that it's already filtered
+		// and fewer pixels need to be transformed.
+		QPixmap drawnPixmap;
+		drawnPixmapScale_ = pixmapScale;
+		if (autoFit_) {
+			drawnPixmap = displayPixmap(QSize((int)(zoom * (float)sourceWidth), (int)(zoom * (float)sourceHeight)));
+		} else {
+			drawnPixmap = *pixmap_;
+			float mipmapScale = zoom / pixmapScale;
+			int level = mipmapScale < 1 ? (int)floor(log(1.0 / mipmapScale) / log(2.0)) : 0;
+			const QPixmap* mipmapPixmap = level > 0 ? mipmap(level) : NULL;
+			if (mipmapPixmap) {
+				drawnPixmap = *mipmapPixmap;
+				drawnPixmapScale_ = (float)drawnPixmap.width() / (float)sourceWidth;
+			}
+		}
+
+		// Maps the unrotated pixmap to the rotated one, for the selection
+		pixmapItemTransform_ = QTransform();
+		if (autoFit_ && rotation_) {
+			QSize unrotatedSize = rotated() ? drawnPixmap.size().transposed() : drawnPixmap.size();
+			pixmapItemTransform_ = QPixmap::trueMatrix(QTransform().rotate(rotation_), unrotatedSize.width(), unrotatedSize.height());
+		}
 
 		pixmapItem_->setPixmap(drawnPixmap);
-		pixmapItem_->setScale(autoFit_ ? 1 : zoom);
+		pixmapItem_->setScale(autoFit_ ? 1 : zoom / drawnPixmapScale_);
+		// What's left to scale down after the mip level is less than half, so
+		// bilinear filtering is enough. Zoomed-in images are not smoothed.
+		pixmapItem_->setTransformationMode(!autoFit_ && zoom < drawnPixmapScale_ ? Qt::SmoothTransformation : Qt::FastTransformation);
 		pixmapItem_->setTransformOriginPoint(QPointF((double)drawnPixmap.width() / 2.0, (double)drawnPixmap.height() / 2.0));
-		pixmapItem_->setRotation(rotation_);
+		pixmapItem_->setRotation(autoFit_ ? 0 : rotation_);
 		pixmapItem_->setPos(
 			floor((winSize.width() - drawnPixmap.size().width()) / 2),
 			floor((winSize.height() - drawnPixmap.size().height()) / 2)
 		);
 
+		// The tiled item is in source coordinates and is centered on the
+		// same point as the pixmap item.
+		pixmapItem_->setVisible(!tiled);
+		tiledImageItem_->setVisible(tiled);
+		if (tiled) {
+			tiledImageItem_->setPlaceholder(*pixmap_);
+			QPointF center = pixmapItem_->pos() + pixmapItem_->transformOriginPoint();
+			tiledImageItem_->setTransformOriginPoint(QPointF((double)sourceWidth / 2.0, (double)sourceHeight / 2.0));
+			tiledImageItem_->setScale(zoom);
+			tiledImageItem_->setRotation(rotation_);
+			tiledImageItem_->setPos(center - tiledImageItem_->transformOriginPoint());
+		}
+
 		if (autoFit_) {
 			scene_->setSceneRect(QRect(0, 0, winSize.width(), winSize.height()));
 		} else {
@@ -1,8 +1,14 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "animationplayer.h"
 #include "consolewidget.h"
+#include "displayrendertask.h"
+#include "imagecache.h"
+#include "imageloader.h"
+#include "mipmaptask.h"
 #include "simpletypes.h"
+#include "tiledimageitem.h"
 
 class XGraphicsView: public QGraphicsView {
 
@@ -21,6 +27,7 @@ protected:
 	void dragEnterEvent(QDragEnterEvent* event);
 	void dragMoveEvent(QDragMoveEvent* event);
 	void dropEvent(QDropEvent* event);
+	void paintEvent(QPaintEvent* event);
 
 private:
 
@@ -45,16 +52,14 @@ class MainWindow : public QMainWindow {
 
 public:
 
-	static const int FullRendering = 1;
-	static const int QuickRendering = 2;
-
 	explicit MainWindow(QWidget *parent = 0);
 	~MainWindow();
-	void updateDisplay(int renderingType);
+	void updateDisplay();
 	void updateSelectionDisplay();
 	void setSource(const QString& v);
 	QString source() const;
 	void reloadSource();
+	mv::FileSignature sourceSignature() const;
 	void doLoopAnimation();
 	void setRotation(int v);
 	int rotation() const;
@@ -72,8 +77,14 @@ public:
 	void setStatusItem(const QString& name, const QString& value);
 	int zoomIndex() const;
 	QPixmap* loadSource(const QString& sourcePath);
+	void prefetchSources(const QStringList& sourcePaths);
+	void setSkimming(bool v);
+	bool skimming() const;
 	QPixmap* pixmap() const;
+	QSize sourceSize() const;
 	mv::ConsoleWidget* console() const;
+	mv::ImageCache* imageCache();
+	void refreshCacheSettings();
 	void showConsole(bool doShow = true);
 	void toggleConsole();
 	void showStatusBar(bool doShow = true);
@@ -88,6 +99,7 @@ public:
 	void clearSourceAndCache();
 	void showProgressBar(bool doShow);
 	void showProgressBarCancelButton(bool doShow);
+	void setProgress(int value, int maximum);
 	void onActionStart();
 	void onActionStop();
 	QMenuBar* menubar();
@@ -102,18 +114,34 @@ protected:
 
 private:
 
-	QTimer* updateDisplayTimer() const;
 	void setZoomIndex(int v);
 	QSize viewContainerSize() const;
 	QPoint mapViewToPixmapItem(const QPoint& point) const;
 	QRectF mapPixmapItemToView(const QRect& rect) const;
+	void setPixmap(const QPixmap* pixmap, const QString& pixmapSource, const QSize& sourceSize = QSize());
+	float pixmapScale() const;
+	QSize decodeSize() const;
+	void loadFullResolutionSource();
+	bool useTiledRendering();
+	bool isVeryLarge() const;
+	bool useMagnifiedRendering();
+	void startAnimation();
+	QPixmap displayPixmap(const QSize& size);
+	const QPixmap* mipmap(int level);
+	void requestMipmaps();
+	void requestDisplayRender(const QString& key, const QSize& size);
 
 	Ui::MainWindow *ui;
 	QGraphicsPixmapItem* pixmapItem_;
+	mv::TiledImageItem* tiledImageItem_;
 	QGraphicsScene* scene_;
 	QGraphicsView* view_;
 	QPixmap* pixmap_;
-	mutable QTimer* updateDisplayTimer_;
+	QString pixmapSource_;
+	QSize sourceSize_;
+	bool pixmapIsPreview_;
+	bool skimming_;
+	QElapsedTimer loadTimer_;
 	QString source_;
 	QGraphicsPixmapItem* loopPixmapItem_;
 	QPixmap* loopPixmap_;
@@ -129,7 +157,27 @@ private:
 	int noZoomIndex_;
 	float beforeScaleFitZoom_;
 	QStringQLabelMap statusLabels_;
-	QCache<QString, QPixmap> pixmapCache_;
+	mv::ImageCache pixmapCache_;
+	mv::ImageCache displayCache_;
+	QTransform pixmapItemTransform_;
+	float drawnPixmapScale_;
+	mv::ImageCache mipmapCache_;
+	QThreadPool mipmapThreadPool_;
+	// Pixmap whose mip chain is being built, or 0
+	qint64 mipmapKey_;
+	QSharedPointer<QAtomicInt> mipmapCanceled_;
+	QThreadPool renderThreadPool_;
+	QString renderKey_;
+	int renderRequestId_;
+	QSharedPointer<QAtomicInt> renderCanceled_;
+	mv::ImageLoader* imageLoader_;
+	mv::AnimationPlayer* animationPlayer_;
+	QSet<QString> animatedSources_;
+	QHash<QString, mv::FileSignature> sourceSignatures_;
+	void setSourceSignature(const QString& filePath, const mv::FileSignature& signature);
+	// Last very large image whose full resolution was not loaded, so that
+	// this is only reported once
+	QString veryLargeWarningSource_;
 	QSplitter* splitter_;
 	mv::ConsoleWidget* console_;
 	QGraphicsRectItem* selectionRectItem_;
@@ -143,13 +191,18 @@ private:
 
 public slots:
 
-	void updateDisplayTimer_timeout();
 	void hideLoopItemTimer_timeout();
 	void splitter_splitterMoved(int pos, int index);
 	void view_mousePress(QMouseEvent* event);
 	void view_mouseRelease(QMouseEvent* event);
 	void view_mouseDrag(QMouseEvent* event);
 	void progressBarCancelButton_linkActivated(const QString&);
+	void imageLoader_imageLoaded(const QString& filePath, const QImage& image, const QSize& sourceSize, bool animated, const mv::FileSignature& signature);
+	void imageLoader_previewLoaded(const QString& filePath, const QImage& image, const QSize& sourceSize);
+	void animationPlayer_frameChanged(const QString& filePath, const QImage& image);
+	void mipmapTask_done(qint64 key, int level, const QImage& image);
+	void mipmapTask_finished(qint64 key);
+	void displayRenderTask_done(const QString& key, const QImage& image, int requestId);
 
 	void consoleLog(const QString& s);
 
@@ -158,6 +211,7 @@ signals:
 	void keypressed(QKeyEvent* event);
 	void closed();
 	void cancelButtonClicked();
+	void sourceLoaded();
 
 };
 
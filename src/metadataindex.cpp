@@ -0,0 +1,262 @@
+#include "exif.h"
+#include "metadataindex.h"
+#include "ziparchive.h"
+
+namespace mv {
+
+namespace {
+
+// Written at the start of the cache files, and changed whenever their format
+// changes so that old files are ignored.
+const quint32 CacheMagic = 0x4d564d31;
+
+}
+
+FileMetadata::FileMetadata() {
+	size = -1;
+	lastModified = -1;
+	captureTime = -1;
+}
+
+MetadataIndexTask::MetadataIndexTask(MetadataIndex* index, const QString& dirPath, const QStringList& fileNames, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	index_ = index;
+	dirPath_ = dirPath;
+	fileNames_ = fileNames;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void MetadataIndexTask::run() {
+	if (canceled_->load()) return;
+
+	FileMetadataHash cached = MetadataIndex::loadCache(dirPath_);
+	FileMetadataHash output;
+	output.reserve(fileNames_.size());
+	bool modified = cached.size() != fileNames_.size();
+
+	for (int i = 0; i < fileNames_.size(); i++) {
+		if (canceled_->load()) return;
+
+		QString fileName = fileNames_[i];
+		QString filePath = dirPath_ + "/" + fileName;
+		qint64 size;
+		qint64 lastModified;
+		if (!MetadataIndex::readFileInfo(filePath, &size, &lastModified)) continue;
+
+		FileMetadataHash::const_iterator it = cached.constFind(fileName);
+		if (it != cached.constEnd() && it->size == size && it->lastModified == lastModified) {
+			output.insert(fileName, *it);
+			continue;
+		}
+
+		output.insert(fileName, MetadataIndex::readMetadata(filePath));
+		modified = true;
+	}
+
+	if (modified && !MetadataIndex::saveCache(dirPath_, output)) qWarning() << "Could not save metadata index of" << dirPath_ << "to" << MetadataIndex::cachePath(dirPath_);
+
+	QMetaObject::invokeMethod(index_, "indexTask_done", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(mv::FileMetadataHash, output));
+}
+
+MetadataReadTask::MetadataReadTask(MetadataIndex* index, const QString& dirPath, const QStringList& fileNames, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	index_ = index;
+	dirPath_ = dirPath;
+	fileNames_ = fileNames;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void MetadataReadTask::run() {
+	FileMetadataHash output;
+	output.reserve(fileNames_.size());
+
+	for (int i = 0; i < fileNames_.size(); i++) {
+		if (canceled_->load()) return;
+		output.insert(fileNames_[i], MetadataIndex::readMetadata(dirPath_ + "/" + fileNames_[i]));
+	}
+
+	QMetaObject::invokeMethod(index_, "readTask_done", Qt::QueuedConnection, Q_ARG(int, requestId_), Q_ARG(mv::FileMetadataHash, output));
+}
+
+MetadataIndex::MetadataIndex(QObject* parent) : QObject(parent) {
+	qRegisterMetaType<mv::FileMetadataHash>("mv::FileMetadataHash");
+
+	complete_ = false;
+	requestId_ = 0;
+	threadPool_.setMaxThreadCount(1);
+}
+
+MetadataIndex::~MetadataIndex() {
+	clear();
+	threadPool_.waitForDone();
+}
+
+// Indexes the given files, replacing the current index. indexed() is
+// emitted once done.
+void MetadataIndex::build(const QString& dirPath, const QStringList& fileNames) {
+	clear();
+
+	dirPath_ = dirPath;
+	requestId_++;
+	canceled_ = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	threadPool_.start(new MetadataIndexTask(this, dirPath_, fileNames, requestId_, canceled_));
+}
+
+void MetadataIndex::clear() {
+	if (canceled_) canceled_->store(1);
+	dirPath_ = "";
+	entries_.clear();
+	complete_ = false;
+	pendingFileNames_.clear();
+	queuedFileNames_.clear();
+}
+
+QString MetadataIndex::directory() const {
+	return dirPath_;
+}
+
+bool MetadataIndex::isComplete() const {
+	return complete_;
+}
+
+// Files that are not part of the index yet (eg. files created since it was
+// built) are queued to be read in the background, and their metadata is
+// invalid until updated() is emitted. Files requested in the same event
+// loop iteration are read by the same task.
+FileMetadata MetadataIndex::metadata(const QString& fileName) {
+	FileMetadataHash::const_iterator it = entries_.constFind(fileName);
+	if (it != entries_.constEnd()) return *it;
+
+	if (dirPath_ != "" && !pendingFileNames_.contains(fileName)) {
+		if (queuedFileNames_.isEmpty()) QMetaObject::invokeMethod(this, "readQueuedFiles", Qt::QueuedConnection);
+		pendingFileNames_.insert(fileName);
+		queuedFileNames_.append(fileName);
+	}
+
+	return FileMetadata();
+}
+
+// EXIF data is not read for files in archives, which therefore have no
+// capture time.
+FileMetadata MetadataIndex::readMetadata(const QString& filePath) {
+	FileMetadata output;
+
+	if (!readFileInfo(filePath, &output.size, &output.lastModified)) return output;
+	if (ZipArchive::isArchiveEntry(filePath)) return output;
+
+	Exif exif(filePath);
+	QDateTime dateTime = exif.dateTime();
+	if (dateTime.isValid()) output.captureTime = dateTime.toMSecsSinceEpoch();
+	output.dimensions = exif.size();
+
+	return output;
+}
+
+// Gets the size and modification time of a file, which can also be in an
+// archive. Returns false if it doesn't exist.
+bool MetadataIndex::readFileInfo(const QString& filePath, qint64* size, qint64* lastModified) {
+	QString archivePath;
+	QString entryName;
+	if (ZipArchive::splitPath(filePath, &archivePath, &entryName)) {
+		QSharedPointer<ZipArchive> archive = ZipArchive::open(archivePath);
+		ZipArchive::Entry entry;
+		if (!archive || !archive->entry(entryName, &entry)) return false;
+		*size = (qint64)entry.size;
+		*lastModified = entry.lastModified.toMSecsSinceEpoch();
+		return true;
+	}
+
+	QFileInfo fileInfo(filePath);
+	if (!fileInfo.exists()) return false;
+	*size = fileInfo.size();
+	*lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+	return true;
+}
+
+QString MetadataIndex::cachePath(const QString& dirPath) {
+	QByteArray hash = QCryptographicHash::hash(dirPath.toUtf8(), QCryptographicHash::Md5);
+	return QString("%1/metadata/%2.dat").arg(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).arg(QString(hash.toHex()));
+}
+
+FileMetadataHash MetadataIndex::loadCache(const QString& dirPath) {
+	FileMetadataHash output;
+
+	QFile file(cachePath(dirPath));
+	if (!file.open(QIODevice::ReadOnly)) return output;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	QString storedDirPath;
+	qint32 count;
+	stream >> magic >> storedDirPath >> count;
+	// The path is checked in case of hash collision
+	if (stream.status() != QDataStream::Ok || magic != CacheMagic || storedDirPath != dirPath || count < 0) return output;
+
+	output.reserve(count);
+	for (int i = 0; i < count; i++) {
+		QString fileName;
+		FileMetadata metadata;
+		qint32 width;
+		qint32 height;
+		stream >> fileName >> metadata.size >> metadata.lastModified >> metadata.captureTime >> width >> height;
+		if (stream.status() != QDataStream::Ok) return FileMetadataHash();
+		metadata.dimensions = QSize(width, height);
+		output.insert(fileName, metadata);
+	}
+
+	return output;
+}
+
+bool MetadataIndex::saveCache(const QString& dirPath, const FileMetadataHash& entries) {
+	QString filePath = cachePath(dirPath);
+	QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+	// Written to a temporary file first, so that an interrupted write
+	// doesn't leave a truncated index behind
+	QSaveFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly)) return false;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream << CacheMagic << dirPath << (qint32)entries.size();
+
+	for (FileMetadataHash::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+		const FileMetadata& metadata = it.value();
+		stream << it.key() << metadata.size << metadata.lastModified << metadata.captureTime << (qint32)metadata.dimensions.width() << (qint32)metadata.dimensions.height();
+	}
+
+	return file.commit();
+}
+
+void MetadataIndex::indexTask_done(int requestId, const mv::FileMetadataHash& entries) {
+	if (requestId != requestId_) return;
+
+	// Files read in the meantime by a MetadataReadTask are kept
+	for (FileMetadataHash::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+		if (!entries_.contains(it.key())) entries_.insert(it.key(), it.value());
+	}
+
+	complete_ = true;
+	emit indexed();
+}
+
+void MetadataIndex::readQueuedFiles() {
+	if (queuedFileNames_.isEmpty() || dirPath_ == "") return;
+	threadPool_.start(new MetadataReadTask(this, dirPath_, queuedFileNames_, requestId_, canceled_));
+	queuedFileNames_.clear();
+}
+
+void MetadataIndex::readTask_done(int requestId, const mv::FileMetadataHash& entries) {
+	if (requestId != requestId_ || dirPath_ == "") return;
+
+	for (FileMetadataHash::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+		entries_.insert(it.key(), it.value());
+		pendingFileNames_.remove(it.key());
+	}
+
+	emit updated();
+}
+
+}
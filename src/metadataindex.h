@@ -0,0 +1,118 @@
+#ifndef MV_METADATAINDEX_H
+#define MV_METADATAINDEX_H
+
+namespace mv {
+
+struct FileMetadata {
+	FileMetadata();
+	qint64 size;
+	// Both in milliseconds since epoch. The capture time is -1 if the file
+	// doesn't have one.
+	qint64 lastModified;
+	qint64 captureTime;
+	QSize dimensions;
+};
+
+typedef QHash<QString, FileMetadata> FileMetadataHash;
+
+class MetadataIndex;
+
+class MetadataIndexTask : public QRunnable {
+
+public:
+
+	MetadataIndexTask(MetadataIndex* index, const QString& dirPath, const QStringList& fileNames, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	MetadataIndex* index_;
+	QString dirPath_;
+	QStringList fileNames_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Reads the metadata of files that were not part of the index when it was
+// built.
+class MetadataReadTask : public QRunnable {
+
+public:
+
+	MetadataReadTask(MetadataIndex* index, const QString& dirPath, const QStringList& fileNames, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	MetadataIndex* index_;
+	QString dirPath_;
+	QStringList fileNames_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Metadata (size, modification time, capture time and dimensions) of the
+// files of a directory, used to sort them. The index is built on a
+// background thread and only reads the file headers, since FreeImage is
+// asked not to load the pixels.
+//
+// Each directory's index is saved to the cache folder. When the directory
+// is indexed again, the files are only stat'ed: entries whose size and
+// modification time haven't changed are reused as they are.
+//
+// Files that are not in the index (eg. files created since it was built)
+// are read in the background too, when their metadata is first requested.
+// Until then, their metadata is invalid, and updated() is emitted once it
+// is available.
+class MetadataIndex : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	MetadataIndex(QObject* parent = 0);
+	~MetadataIndex();
+	void build(const QString& dirPath, const QStringList& fileNames);
+	void clear();
+	QString directory() const;
+	bool isComplete() const;
+	FileMetadata metadata(const QString& fileName);
+	static FileMetadata readMetadata(const QString& filePath);
+	static bool readFileInfo(const QString& filePath, qint64* size, qint64* lastModified);
+	static QString cachePath(const QString& dirPath);
+	static FileMetadataHash loadCache(const QString& dirPath);
+	static bool saveCache(const QString& dirPath, const FileMetadataHash& entries);
+
+private:
+
+	QString dirPath_;
+	FileMetadataHash entries_;
+	bool complete_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+	QThreadPool threadPool_;
+	// Files whose metadata has been requested but not read yet, and those
+	// of them that are not in a read task yet
+	QSet<QString> pendingFileNames_;
+	QStringList queuedFileNames_;
+
+public slots:
+
+	void indexTask_done(int requestId, const mv::FileMetadataHash& entries);
+	void readTask_done(int requestId, const mv::FileMetadataHash& entries);
+	void readQueuedFiles();
+
+signals:
+
+	void indexed();
+	void updated();
+
+};
+
+}
+
+Q_DECLARE_METATYPE(mv::FileMetadataHash)
+
+#endif // MV_METADATAINDEX_H
@@ -0,0 +1,31 @@
+#include "mipmaptask.h"
+#include "resampler.h"
+
+namespace mv {
+
+MipmapTask::MipmapTask(QObject* receiver, qint64 key, const QImage& image, QSharedPointer<QAtomicInt> canceled) {
+	receiver_ = receiver;
+	key_ = key;
+	image_ = image;
+	canceled_ = canceled;
+}
+
+void MipmapTask::run() {
+	QImage level = image_;
+	int levelIndex = 0;
+
+	while (qMax(level.width(), level.height()) / 2 >= MinSize) {
+		if (canceled_->load()) return;
+
+		QSize size(qMax(1, level.width() / 2), qMax(1, level.height() / 2));
+		level = resampler::scaled(level, size, Qt::IgnoreAspectRatio, resampler::Box);
+		if (level.isNull()) break;
+		levelIndex++;
+
+		QMetaObject::invokeMethod(receiver_, "mipmapTask_done", Qt::QueuedConnection, Q_ARG(qint64, key_), Q_ARG(int, levelIndex), Q_ARG(QImage, level));
+	}
+
+	QMetaObject::invokeMethod(receiver_, "mipmapTask_finished", Qt::QueuedConnection, Q_ARG(qint64, key_));
+}
+
+}
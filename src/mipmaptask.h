@@ -0,0 +1,32 @@
+#ifndef MV_MIPMAPTASK_H
+#define MV_MIPMAPTASK_H
+
+namespace mv {
+
+// Builds the mip levels of an image, each level being half the size of the
+// previous one, down to MinSize. Levels are box filtered from the previous
+// one, so building the whole chain costs about a third of a single scaling
+// pass over the image. Each level is posted to the receiver's
+// mipmapTask_done() slot as soon as it's ready, level 1 (half size) first,
+// then mipmapTask_finished() is called once there are no more levels.
+class MipmapTask : public QRunnable {
+
+public:
+
+	static const int MinSize = 32;
+
+	MipmapTask(QObject* receiver, qint64 key, const QImage& image, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	QObject* receiver_;
+	qint64 key_;
+	QImage image_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+}
+
+#endif // MV_MIPMAPTASK_H
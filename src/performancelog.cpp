@@ -0,0 +1,82 @@
+#include "performancelog.h"
+
+namespace mv {
+namespace performanceLog {
+
+namespace {
+
+QMutex mutex;
+QHash<QString, QList<qint64> > sessionSamples;
+QHash<QString, QHash<QString, qint64> > imageTimes;
+QStringList imageOrder; // Least recently recorded first
+
+const char* stages[] = { "io", "decode", "load", "scale", "update", "paint" };
+const int stageCount = 6;
+
+// Caller must hold the mutex
+QHash<QString, qint64>& imageEntry(const QString& filePath) {
+	if (!imageTimes.contains(filePath)) {
+		imageOrder << filePath;
+		if (imageOrder.size() > ImageCount) imageTimes.remove(imageOrder.takeFirst());
+	}
+	return imageTimes[filePath];
+}
+
+QString formatTime(qint64 microseconds) {
+	return QString("%1ms").arg((double)microseconds / 1000.0, 0, 'f', 1);
+}
+
+// Nearest-rank percentile of sorted values
+qint64 percentile(const QList<qint64>& sortedValues, int p) {
+	if (sortedValues.isEmpty()) return 0;
+	int rank = (int)ceil((double)p / 100.0 * (double)sortedValues.size());
+	return sortedValues[qBound(0, rank - 1, sortedValues.size() - 1)];
+}
+
+}
+
+void record(const QString& stage, const QString& filePath, qint64 microseconds) {
+	QMutexLocker locker(&mutex);
+
+	QList<qint64>& samples = sessionSamples[stage];
+	samples << microseconds;
+	if (samples.size() > SampleCount) samples.removeFirst();
+
+	if (filePath != "") imageEntry(filePath)[stage] = microseconds;
+}
+
+void recordCacheHit(const QString& filePath, bool hit) {
+	QMutexLocker locker(&mutex);
+	imageEntry(filePath)["cache"] = hit ? 1 : 0;
+}
+
+// eg. "cache miss, io 3.1ms, decode 84.2ms, load 95.0ms, scale 12.4ms"
+QString imageSummary(const QString& filePath) {
+	QMutexLocker locker(&mutex);
+	if (!imageTimes.contains(filePath)) return "";
+
+	const QHash<QString, qint64>& times = imageTimes[filePath];
+	QStringList output;
+	if (times.contains("cache")) output << (times["cache"] ? "cache hit" : "cache miss");
+	for (int i = 0; i < stageCount; i++) {
+		if (times.contains(stages[i])) output << QString("%1 %2").arg(stages[i]).arg(formatTime(times[stages[i]]));
+	}
+	return output.join(", ");
+}
+
+// eg. "decode p50 80.1ms p95 210.4ms (n=42); scale p50 ..."
+QString sessionSummary() {
+	QMutexLocker locker(&mutex);
+
+	QStringList output;
+	for (int i = 0; i < stageCount; i++) {
+		if (!sessionSamples.contains(stages[i])) continue;
+		QList<qint64> values = sessionSamples[stages[i]];
+		std::sort(values.begin(), values.end());
+		output << QString("%1 p50 %2 p95 %3 (n=%4)").arg(stages[i]).arg(formatTime(percentile(values, 50))).arg(formatTime(percentile(values, 95))).arg(values.size());
+	}
+	return output.join("; ");
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#ifndef MV_PERFORMANCELOG_H
+#define MV_PERFORMANCELOG_H
+
+namespace mv {
+
+// Timings of the stages of displaying an image, to find out whether a slow
+// image is slow to read, decode, scale or paint. Timings are kept both per
+// image (for the last images only) and per stage for the whole session (the
+// last SampleCount samples), from which percentiles are computed. Times are
+// in microseconds. All the functions are thread-safe.
+//
+// Stages are:
+//
+// - io: time spent reading the file while decoding it
+// - decode: decoding time, excluding io
+// - load: time between the image being requested and it being displayed
+// - scale: high quality scaling of the display bitmap
+// - update: layout of the scene (MainWindow::updateDisplay)
+// - paint: painting of the view
+namespace performanceLog {
+
+	const int SampleCount = 1000;
+	const int ImageCount = 100;
+
+	void record(const QString& stage, const QString& filePath, qint64 microseconds);
+	void recordCacheHit(const QString& filePath, bool hit);
+	QString imageSummary(const QString& filePath);
+	QString sessionSummary();
+
+}
+
+}
+
+#endif // MV_PERFORMANCELOG_H
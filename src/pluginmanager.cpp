@@ -21,6 +21,10 @@ PluginManager::PluginManager() {
 	jsImaging_ = NULL;
 	jsSystem_ = NULL;
 	canceling_ = false;
+
+	batchScheduler_ = new BatchScheduler(this);
+	connect(batchScheduler_, SIGNAL(progress(int, int)), this, SLOT(batchScheduler_progress(int, int)));
+	connect(batchScheduler_, SIGNAL(finished()), this, SLOT(batchScheduler_finished()));
 }
 
 bool PluginManager::loadPlugin(const QString& folderPath) {
@@ -69,7 +73,7 @@ QStringList PluginManager::replaceVariables(const QStringList& command) {
 }
 
 void PluginManager::execAction(const QString& actionName, const QStringList& filePaths) {
-	if (actionThread_) {
+	if (actionThread_ || batchScheduler_->isRunning()) {
 		qWarning() << "New actions cannot be executed now as another action is already running.";
 		return;
 	}
@@ -109,49 +113,48 @@ void PluginManager::execAction(const QString& actionName, const QStringList& fil
 			return;
 		}
 
+		QString scriptFilePath = plugin->actionScriptFilePath(action->id());
+		QFile scriptFile(scriptFilePath);
+		if (!scriptFile.open(QIODevice::ReadOnly)) {
+			qWarning() << "Cannot open script file:" << scriptFilePath;
+			return;
+		}
+
+		QTextStream stream(&scriptFile);
+		QString contents = stream.readAll();
+		scriptFile.close();
+
+		// Files of a batch are processed in parallel, each by its own run
+		// of the script
+		if (filePaths.size() > 1 && action->batchModeSupported()) {
+			connect(app->mainWindow(), SIGNAL(cancelButtonClicked()), this, SLOT(mainWindow_cancelButtonClicked()), Qt::UniqueConnection);
+			app->mainWindow()->onActionStart();
+			batchScheduler_->start(plugin, action, contents, scriptFilePath, filePaths);
+			return;
+		}
+
 		if (!scriptEngine_) {
-			scriptEngine_ = new QScriptEngine();
-			QObject* jsApplication = new jsapi::Application(scriptEngine_);
-			jsConsole_ = new jsapi::Console();
-			QObject* jsFileInfo = new jsapi::FileInfo();
-			jsImaging_ = new jsapi::Imaging(scriptEngine_);
-			QObject* jsUi = new jsapi::Ui(scriptEngine_);
-			jsSystem_ = new jsapi::System(scriptEngine_);
-			scriptEngine_->globalObject().setProperty("application", scriptEngine_->newQObject(jsApplication));
-			scriptEngine_->globalObject().setProperty("console", scriptEngine_->newQObject(jsConsole_));
-			scriptEngine_->globalObject().setProperty("fileinfo", scriptEngine_->newQObject(jsFileInfo));
-			scriptEngine_->globalObject().setProperty("imaging", scriptEngine_->newQObject(jsImaging_));
-			scriptEngine_->globalObject().setProperty("ui", scriptEngine_->newQObject(jsUi));
-			scriptEngine_->globalObject().setProperty("system", scriptEngine_->newQObject(jsSystem_));
+			scriptEngine_ = createScriptEngine();
+			jsConsole_ = scriptEngine_->globalObject().property("console").toQObject();
+			jsImaging_ = scriptEngine_->globalObject().property("imaging").toQObject();
+			jsSystem_ = scriptEngine_->globalObject().property("system").toQObject();
 		}
 
 		jsapi::Console* c = (jsapi::Console*)jsConsole_;
 		c->saveVScrollValue(app->mainWindow()->console()->documentSize().height());
 
-		QPixmap* pixmap = app->mainWindow()->pixmap();
 		QObject* jsInput = new jsapi::Input(
 			scriptEngine_,
 			filePaths, app->mainWindow()->selectionRect(),
-			pixmap ? pixmap->size() : QSize()
+			app->mainWindow()->sourceSize()
 		);
 		scriptEngine_->globalObject().setProperty("input", scriptEngine_->newQObject(jsInput));
 
 		QObject* jsPlugin = new jsapi::Plugin(scriptEngine_, plugin, action);
 		scriptEngine_->globalObject().setProperty("plugin", scriptEngine_->newQObject(jsPlugin));
 
-		QString scriptFilePath = plugin->actionScriptFilePath(action->id());
-		QFile scriptFile(scriptFilePath);
-		if (!scriptFile.open(QIODevice::ReadOnly)) {
-			qWarning() << "Cannot open script file:" << scriptFilePath;
-			return;
-		}
-
 		((jsapi::System*)jsSystem_)->resetState();
 
-		QTextStream stream(&scriptFile);
-		QString contents = stream.readAll();
-		scriptFile.close();
-
 		// TOOD: also gray out image to show that app is disabled
 
 		connect(app->mainWindow(), SIGNAL(cancelButtonClicked()), this, SLOT(mainWindow_cancelButtonClicked()), Qt::UniqueConnection);
@@ -165,15 +168,48 @@ void PluginManager::execAction(const QString& actionName, const QStringList& fil
 	}
 }
 
-void PluginManager::actionThread_finished() {
-	QScriptValue errorValue = scriptEngine_->uncaughtException();
-	if (errorValue.isValid()) {
-		qWarning() << qPrintable(QString("%1 at line %2").arg(errorValue.toString()).arg(scriptEngine_->uncaughtExceptionLineNumber()));
-		QStringList backtrace = scriptEngine_->uncaughtExceptionBacktrace();
-		for (int i = 0; i < backtrace.size(); i++) {
-			qDebug() << qPrintable("    " + backtrace[i]);
-		}
+// Engine with the objects of the script API, except for the input and the
+// plugin, which depend on the action. The objects are children of the engine.
+QScriptEngine* PluginManager::createScriptEngine() {
+	QScriptEngine* engine = new QScriptEngine();
+
+	QObject* jsApplication = new jsapi::Application(engine);
+	QObject* jsConsole = new jsapi::Console();
+	QObject* jsFileInfo = new jsapi::FileInfo();
+	QObject* jsImaging = new jsapi::Imaging(engine);
+	QObject* jsUi = new jsapi::Ui(engine);
+	QObject* jsSystem = new jsapi::System(engine);
+
+	jsApplication->setParent(engine);
+	jsConsole->setParent(engine);
+	jsFileInfo->setParent(engine);
+	jsImaging->setParent(engine);
+	jsUi->setParent(engine);
+	jsSystem->setParent(engine);
+
+	engine->globalObject().setProperty("application", engine->newQObject(jsApplication));
+	engine->globalObject().setProperty("console", engine->newQObject(jsConsole));
+	engine->globalObject().setProperty("fileinfo", engine->newQObject(jsFileInfo));
+	engine->globalObject().setProperty("imaging", engine->newQObject(jsImaging));
+	engine->globalObject().setProperty("ui", engine->newQObject(jsUi));
+	engine->globalObject().setProperty("system", engine->newQObject(jsSystem));
+
+	return engine;
+}
+
+void PluginManager::logUncaughtException(QScriptEngine* engine) {
+	QScriptValue errorValue = engine->uncaughtException();
+	if (!errorValue.isValid()) return;
+
+	qWarning() << qPrintable(QString("%1 at line %2").arg(errorValue.toString()).arg(engine->uncaughtExceptionLineNumber()));
+	QStringList backtrace = engine->uncaughtExceptionBacktrace();
+	for (int i = 0; i < backtrace.size(); i++) {
+		qDebug() << qPrintable("    " + backtrace[i]);
 	}
+}
+
+void PluginManager::actionThread_finished() {
+	logUncaughtException(scriptEngine_);
 
 	Application* app = Application::instance();
 	disconnect(app->mainWindow(), SIGNAL(cancelButtonClicked()), this, SLOT(mainWindow_cancelButtonClicked()));
@@ -183,7 +219,22 @@ void PluginManager::actionThread_finished() {
 	actionThread_ = NULL;
 }
 
+void PluginManager::batchScheduler_progress(int doneCount, int totalCount) {
+	Application::instance()->mainWindow()->setProgress(doneCount, totalCount);
+}
+
+void PluginManager::batchScheduler_finished() {
+	Application* app = Application::instance();
+	disconnect(app->mainWindow(), SIGNAL(cancelButtonClicked()), this, SLOT(mainWindow_cancelButtonClicked()));
+	app->mainWindow()->onActionStop();
+}
+
 void PluginManager::mainWindow_cancelButtonClicked() {
+	if (batchScheduler_->isRunning()) {
+		batchScheduler_->cancel();
+		return;
+	}
+
 	if (!actionThread_) return;
 	if (canceling_) return;
 
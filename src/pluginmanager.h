@@ -2,6 +2,7 @@
 #define PLUGINMANAGER_H
 
 #include "actionthread.h"
+#include "batchscheduler.h"
 #include "plugin.h"
 #include "progressbardialog.h"
 
@@ -18,6 +19,8 @@ public:
 	void loadPlugins(const QString& folderPath);
 	PluginVector plugins() const;
 	void execAction(const QString& actionName, const QStringList& filePaths);
+	static QScriptEngine* createScriptEngine();
+	static void logUncaughtException(QScriptEngine* engine);
 
 private:
 
@@ -30,12 +33,15 @@ private:
 	QObject* jsImaging_;
 	QObject* jsSystem_;
 	ActionThread* actionThread_;
+	BatchScheduler* batchScheduler_;
 	bool canceling_;
 
 public slots:
 
 	void packageManager_installationDone();
 	void actionThread_finished();
+	void batchScheduler_progress(int doneCount, int totalCount);
+	void batchScheduler_finished();
 	void mainWindow_cancelButtonClicked();
 
 };
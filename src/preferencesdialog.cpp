@@ -64,7 +64,17 @@ void PreferencesDialog::rebuildCurrentTab() {
 
 		refreshShortcutControls();
 	} else if (currentWidget == ui->generalTab) {
-
+		mv::Settings settings;
+		ui->imageCacheSizeSpinBox->setValue(settings.value("imageCacheSize").toInt());
+		ui->useThumbnailCacheCheckBox->setChecked(settings.value("useThumbnailCache").toBool());
+
+		mv::ImageCache* cache = mv::Application::instance()->mainWindow()->imageCache();
+		ui->imageCacheStatsLabel->setText(tr("%1 images, %2 MB used. Hits: %3, misses: %4, evictions: %5")
+			.arg(cache->count())
+			.arg(cache->totalBytes() / (1024 * 1024))
+			.arg(cache->hits())
+			.arg(cache->misses())
+			.arg(cache->evictions()));
 	}
 }
 
@@ -132,6 +142,12 @@ void PreferencesDialog::buttonBox_accepted() {
 
 		if (shortcutsChanged) mv::Application::instance()->refreshActionShortcuts();
 	}
+
+	if (openedTabs_.find(ui->generalTab) != openedTabs_.end()) {
+		settings.setValue("imageCacheSize", ui->imageCacheSizeSpinBox->value());
+		settings.setValue("useThumbnailCache", ui->useThumbnailCacheCheckBox->isChecked());
+		mv::Application::instance()->mainWindow()->refreshCacheSettings();
+	}
 }
 
 void PreferencesDialog::refreshShortcutControls() {
@@ -0,0 +1,92 @@
+#include "prefetchscheduler.h"
+
+namespace mv {
+
+PrefetchScheduler::PrefetchScheduler() {
+	ahead_ = 3;
+	behind_ = 1;
+	maxAhead_ = 16;
+	lastDirection_ = +1;
+	timer_.start();
+}
+
+void PrefetchScheduler::setAhead(int v) {
+	ahead_ = v;
+}
+
+void PrefetchScheduler::setBehind(int v) {
+	behind_ = v;
+}
+
+void PrefetchScheduler::setMaxAhead(int v) {
+	maxAhead_ = v;
+}
+
+void PrefetchScheduler::onNavigate(int direction) {
+	// When the direction changes, the previous speed is no longer relevant
+	if (direction != lastDirection_) {
+		navigationTimes_.clear();
+		lastDirection_ = direction;
+	}
+
+	qint64 now = timer_.elapsed();
+	navigationTimes_ << now;
+	while (navigationTimes_.size() && now - navigationTimes_.first() > 1000) navigationTimes_.removeFirst();
+}
+
+// Number of images to prefetch in the browsing direction. One extra image
+// is added for each navigation step done during the last second.
+int PrefetchScheduler::ahead() const {
+	int recentSteps = 0;
+	qint64 now = timer_.elapsed();
+	for (int i = 0; i < navigationTimes_.size(); i++) {
+		if (now - navigationTimes_[i] <= 1000) recentSteps++;
+	}
+
+	// A single step is not a sign that the user is going fast
+	if (recentSteps <= 1) recentSteps = 0;
+
+	int output = ahead_ + recentSteps;
+	return output > maxAhead_ ? maxAhead_ : output;
+}
+
+// True if the last two navigation steps happened within SkimInterval of each
+// other, and the last one within SkimInterval of now. A single key press
+// doesn't count, but key auto-repeat does.
+bool PrefetchScheduler::isSkimming() const {
+	int count = navigationTimes_.size();
+	if (count < 2) return false;
+	qint64 last = navigationTimes_[count - 1];
+	if (last - navigationTimes_[count - 2] > SkimInterval) return false;
+	return timer_.elapsed() - last <= SkimInterval;
+}
+
+// Returns the indexes of the images to prefetch, most important first. The
+// list doesn't include the current image and contains at most `maxImages`
+// indexes, or is unbounded if `maxImages` is negative.
+IntVector PrefetchScheduler::window(int count, int index, int direction, int maxImages) const {
+	IntVector output;
+	if (count <= 1 || index < 0 || index >= count) return output;
+
+	int ahead = this->ahead();
+	int behind = behind_;
+	int distance = ahead > behind ? ahead : behind;
+
+	for (int i = 1; i <= distance; i++) {
+		for (int side = 0; side < 2; side++) {
+			if (side == 0 && i > ahead) continue;
+			if (side == 1 && i > behind) continue;
+			if (maxImages >= 0 && (int)output.size() >= maxImages) return output;
+
+			int step = side == 0 ? direction : -direction;
+			// Wrap around since that's what nextSource() and previousSource() do
+			int n = ((index + i * step) % count + count) % count;
+			if (n == index) continue;
+			if (std::find(output.begin(), output.end(), n) == output.end()) output.push_back(n);
+		}
+	}
+
+	return output;
+}
+
+}
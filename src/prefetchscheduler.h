@@ -0,0 +1,45 @@
+#ifndef MV_PREFETCHSCHEDULER_H
+#define MV_PREFETCHSCHEDULER_H
+
+#include "simpletypes.h"
+
+namespace mv {
+
+// Decides which images around the current one should be kept decoded. The
+// window extends `ahead` images in the browsing direction and `behind`
+// images in the other direction, and is widened in the browsing direction
+// as navigation speeds up (eg. when an arrow key is held down). Directions
+// are given as +1 (forward) or -1 (backward). The window is made of indexes
+// in the source list, nearest images first.
+//
+// The scheduler also tells whether the user is skimming through the images,
+// ie. navigating faster than images can be decoded.
+class PrefetchScheduler {
+
+public:
+
+	static const int SkimInterval = 200;
+
+	PrefetchScheduler();
+	void setAhead(int v);
+	void setBehind(int v);
+	void setMaxAhead(int v);
+	void onNavigate(int direction);
+	IntVector window(int count, int index, int direction, int maxImages) const;
+	int ahead() const;
+	bool isSkimming() const;
+
+private:
+
+	int ahead_;
+	int behind_;
+	int maxAhead_;
+	int lastDirection_;
+	QElapsedTimer timer_;
+	QList<qint64> navigationTimes_;
+
+};
+
+}
+
+#endif // MV_PREFETCHSCHEDULER_H
@@ -0,0 +1,351 @@
+#include "resampler.h"
+#include "simpletypes.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MV_RESAMPLER_X86
+#include <immintrin.h>
+#endif
+
+namespace mv {
+namespace resampler {
+
+namespace {
+
+// Source pixels that contribute to each output pixel (along one axis), and
+// their normalized weights. The weights of output pixel `i` start at
+// `i * maxCount`.
+struct Contributions {
+	IntVector first;
+	IntVector count;
+	FloatVector weights;
+	int maxCount;
+};
+
+struct Job {
+	const uchar* sourceBits;
+	int sourceBytesPerLine;
+	int sourceWidth;
+	uchar* outputBits;
+	int outputBytesPerLine;
+	int outputWidth;
+	bool premultiplied;
+	const Contributions* horizontal;
+	const Contributions* vertical;
+};
+
+typedef void (*AccumulateRowFunction)(float* buffer, const uchar* row, int count, float weight);
+typedef void (*ConvolveRowFunction)(const float* buffer, uchar* row, const Contributions& contributions, int width);
+
+const double Pi = 3.14159265358979323846;
+
+double sinc(double x) {
+	if (x == 0.0) return 1.0;
+	x *= Pi;
+	return sin(x) / x;
+}
+
+double lanczos3(double x) {
+	if (x <= -3.0 || x >= 3.0) return 0.0;
+	return sinc(x) * sinc(x / 3.0);
+}
+
+Contributions computeContributions(int sourceSize, int outputSize, Filter filter) {
+	Contributions output;
+	double scale = (double)sourceSize / (double)outputSize;
+	// When downscaling, the filter is stretched so that it covers all the
+	// source pixels that map to an output pixel.
+	double filterScale = qMax(scale, 1.0);
+	double radius = filter == Box ? scale / 2.0 : 3.0 * filterScale;
+
+	output.maxCount = qMax(1, (int)ceil(radius * 2.0) + 2);
+	output.first.resize(outputSize);
+	output.count.resize(outputSize);
+	output.weights.assign((size_t)outputSize * output.maxCount, 0.0f);
+
+	std::vector<double> weights(output.maxCount);
+
+	for (int i = 0; i < outputSize; i++) {
+		double center = ((double)i + 0.5) * scale;
+		int left = qMax(0, (int)floor(center - radius));
+		int right = qMin(sourceSize, (int)ceil(center + radius));
+		int count = 0;
+		double total = 0.0;
+
+		if (filter == Box && scale <= 1.0) {
+			// Nearest neighbour
+			left = qBound(0, (int)floor(center), sourceSize - 1);
+			weights[count++] = 1.0;
+			total = 1.0;
+		} else {
+			for (int j = left; j < right && count < output.maxCount; j++) {
+				double w;
+				if (filter == Box) {
+					// Part of the source pixel that is covered by the output pixel
+					w = qMin(center + radius, (double)(j + 1)) - qMax(center - radius, (double)j);
+				} else {
+					w = lanczos3(((double)j + 0.5 - center) / filterScale);
+				}
+				weights[count++] = w;
+				total += w;
+			}
+		}
+
+		// Source pixels past the edges are simply left out, so the weights
+		// are normalized again.
+		if (total == 0.0) total = 1.0;
+
+		output.first[i] = left;
+		output.count[i] = count;
+		float* outputWeights = &output.weights[(size_t)i * output.maxCount];
+		for (int k = 0; k < count; k++) outputWeights[k] = (float)(weights[k] / total);
+	}
+
+	return output;
+}
+
+void accumulateRowGeneric(float* buffer, const uchar* row, int count, float weight) {
+	for (int i = 0; i < count; i++) buffer[i] += weight * (float)row[i];
+}
+
+void convolveRowGeneric(const float* buffer, uchar* row, const Contributions& contributions, int width) {
+	for (int x = 0; x < width; x++) {
+		const float* weights = &contributions.weights[(size_t)x * contributions.maxCount];
+		const float* pixels = buffer + contributions.first[x] * 4;
+		int count = contributions.count[x];
+
+		float sums[4] = { 0, 0, 0, 0 };
+		for (int k = 0; k < count; k++) {
+			for (int c = 0; c < 4; c++) sums[c] += weights[k] * pixels[k * 4 + c];
+		}
+
+		for (int c = 0; c < 4; c++) row[x * 4 + c] = (uchar)qBound(0, (int)floor(sums[c] + 0.5f), 255);
+	}
+}
+
+#ifdef MV_RESAMPLER_X86
+
+__attribute__((target("sse4.1")))
+void accumulateRowSse41(float* buffer, const uchar* row, int count, float weight) {
+	__m128 w = _mm_set1_ps(weight);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		int bytes;
+		memcpy(&bytes, row + i, 4);
+		__m128 v = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+		_mm_storeu_ps(buffer + i, _mm_add_ps(_mm_loadu_ps(buffer + i), _mm_mul_ps(v, w)));
+	}
+	for (; i < count; i++) buffer[i] += weight * (float)row[i];
+}
+
+__attribute__((target("avx2")))
+void accumulateRowAvx2(float* buffer, const uchar* row, int count, float weight) {
+	__m256 w = _mm256_set1_ps(weight);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(row + i))));
+		_mm256_storeu_ps(buffer + i, _mm256_add_ps(_mm256_loadu_ps(buffer + i), _mm256_mul_ps(v, w)));
+	}
+	for (; i < count; i++) buffer[i] += weight * (float)row[i];
+}
+
+// The four channels of a pixel fit in one SSE register, so each tap is a
+// single multiply-add. The conversion back to bytes saturates, which takes
+// care of the Lanczos overshoots.
+__attribute__((target("sse4.1")))
+void convolveRowSse41(const float* buffer, uchar* row, const Contributions& contributions, int width) {
+	for (int x = 0; x < width; x++) {
+		const float* weights = &contributions.weights[(size_t)x * contributions.maxCount];
+		const float* pixels = buffer + contributions.first[x] * 4;
+		int count = contributions.count[x];
+
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < count; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pixels + k * 4), _mm_set1_ps(weights[k])));
+		}
+
+		__m128i v = _mm_cvtps_epi32(sum);
+		v = _mm_packs_epi32(v, v);
+		v = _mm_packus_epi16(v, v);
+		int bytes = _mm_cvtsi128_si32(v);
+		memcpy(row + x * 4, &bytes, 4);
+	}
+}
+
+#endif
+
+InstructionSet detectInstructionSet() {
+	#ifdef MV_RESAMPLER_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return Avx2;
+	if (__builtin_cpu_supports("sse4.1")) return Sse41;
+	#endif
+	return Generic;
+}
+
+// Set to a lower level than the supported one by tests and benchmarks, or
+// -1 to use the supported one
+QAtomicInt forcedInstructionSet(-1);
+
+InstructionSet activeInstructionSet() {
+	int v = forcedInstructionSet.load();
+	return v < 0 ? supportedInstructionSet() : (InstructionSet)v;
+}
+
+AccumulateRowFunction accumulateRowFunction() {
+	#ifdef MV_RESAMPLER_X86
+	if (activeInstructionSet() == Avx2) return accumulateRowAvx2;
+	if (activeInstructionSet() == Sse41) return accumulateRowSse41;
+	#endif
+	return accumulateRowGeneric;
+}
+
+ConvolveRowFunction convolveRowFunction() {
+	#ifdef MV_RESAMPLER_X86
+	if (activeInstructionSet() != Generic) return convolveRowSse41;
+	#endif
+	return convolveRowGeneric;
+}
+
+// Color channels of premultiplied pixels can't be larger than alpha, which
+// Lanczos overshoots might cause.
+void fixPremultipliedRow(uchar* row, int width) {
+	QRgb* pixels = (QRgb*)row;
+	for (int x = 0; x < width; x++) {
+		QRgb p = pixels[x];
+		int a = qAlpha(p);
+		if (qRed(p) > a || qGreen(p) > a || qBlue(p) > a) pixels[x] = qRgba(qMin(qRed(p), a), qMin(qGreen(p), a), qMin(qBlue(p), a), a);
+	}
+}
+
+void resampleRows(const Job& job, int y1, int y2) {
+	AccumulateRowFunction accumulateRow = accumulateRowFunction();
+	ConvolveRowFunction convolveRow = convolveRowFunction();
+
+	int bufferSize = job.sourceWidth * 4;
+	FloatVector buffer(bufferSize);
+	const Contributions& vertical = *job.vertical;
+
+	for (int y = y1; y < y2; y++) {
+		std::fill(buffer.begin(), buffer.end(), 0.0f);
+
+		const float* weights = &vertical.weights[(size_t)y * vertical.maxCount];
+		for (int k = 0; k < vertical.count[y]; k++) {
+			const uchar* sourceRow = job.sourceBits + (qint64)(vertical.first[y] + k) * job.sourceBytesPerLine;
+			accumulateRow(&buffer[0], sourceRow, bufferSize, weights[k]);
+		}
+
+		uchar* outputRow = job.outputBits + (qint64)y * job.outputBytesPerLine;
+		convolveRow(&buffer[0], outputRow, *job.horizontal, job.outputWidth);
+		if (job.premultiplied) fixPremultipliedRow(outputRow, job.outputWidth);
+	}
+}
+
+class ResampleTask : public QRunnable {
+
+public:
+
+	ResampleTask(const Job& job, int y1, int y2, QSemaphore* done) {
+		job_ = job;
+		y1_ = y1;
+		y2_ = y2;
+		done_ = done;
+	}
+
+	void run() {
+		resampleRows(job_, y1_, y2_);
+		done_->release();
+	}
+
+private:
+
+	Job job_;
+	int y1_;
+	int y2_;
+	QSemaphore* done_;
+
+};
+
+// Shared by all the calls so that threads are not created for each image.
+// Callers wait for their own bands only, so calls from several threads
+// don't block each other.
+Q_GLOBAL_STATIC(QThreadPool, threadPool)
+
+// Below this many output rows per band, the threading overhead is not worth
+// it.
+const int MinBandRows = 32;
+
+}
+
+QImage scaled(const QImage& image, const QSize& size, Qt::AspectRatioMode aspectRatioMode, Filter filter) {
+	if (image.isNull()) return QImage();
+
+	QSize outputSize = image.size().scaled(size, aspectRatioMode);
+	if (outputSize.width() <= 0 || outputSize.height() <= 0) return QImage();
+
+	QImage::Format format = image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+	QImage source = image.format() == format ? image : image.convertToFormat(format);
+	if (outputSize == source.size()) return source;
+
+	if (filter == Auto) {
+		double reduction = qMin((double)source.width() / (double)outputSize.width(), (double)source.height() / (double)outputSize.height());
+		filter = reduction >= 4.0 ? Box : Lanczos3;
+	}
+
+	QImage output(outputSize, format);
+	if (output.isNull()) return QImage();
+
+	Contributions horizontal = computeContributions(source.width(), outputSize.width(), filter);
+	Contributions vertical = computeContributions(source.height(), outputSize.height(), filter);
+
+	Job job;
+	job.sourceBits = source.constBits();
+	job.sourceBytesPerLine = source.bytesPerLine();
+	job.sourceWidth = source.width();
+	job.outputBits = output.bits();
+	job.outputBytesPerLine = output.bytesPerLine();
+	job.outputWidth = outputSize.width();
+	job.premultiplied = format == QImage::Format_ARGB32_Premultiplied;
+	job.horizontal = &horizontal;
+	job.vertical = &vertical;
+
+	int height = outputSize.height();
+	int bandCount = qBound(1, height / MinBandRows, qMax(1, QThread::idealThreadCount()));
+	int bandRows = (height + bandCount - 1) / bandCount;
+
+	// The calling thread processes the first band itself
+	QSemaphore done;
+	int taskCount = 0;
+	for (int y = bandRows; y < height; y += bandRows) {
+		threadPool()->start(new ResampleTask(job, y, qMin(y + bandRows, height), &done));
+		taskCount++;
+	}
+
+	resampleRows(job, 0, qMin(bandRows, height));
+	done.acquire(taskCount);
+
+	return output;
+}
+
+// Most advanced instruction set supported by both the build and the CPU
+InstructionSet supportedInstructionSet() {
+	static InstructionSet output = detectInstructionSet();
+	return output;
+}
+
+// Restricts the inner loops to the given instruction set, so that all the
+// code paths can be compared on the same machine. Levels that are not
+// supported fall back to the supported one.
+void setInstructionSet(InstructionSet v) {
+	forcedInstructionSet.store(v < supportedInstructionSet() ? (int)v : -1);
+}
+
+// Name of the instruction set that is being used
+QString instructionSet() {
+	InstructionSet v = activeInstructionSet();
+	if (v == Avx2) return "AVX2";
+	if (v == Sse41) return "SSE4.1";
+	return "Generic";
+}
+
+}
+}
@@ -0,0 +1,45 @@
+#ifndef MV_RESAMPLER_H
+#define MV_RESAMPLER_H
+
+namespace mv {
+
+// High quality image scaling, used instead of Qt::SmoothTransformation
+// which is single-threaded and slow on large images.
+//
+// Scaling is separable: for each output row, the source rows it depends on
+// are first combined into a floating point row buffer (vertical pass), which
+// is then resampled horizontally into the output row. Output rows are split
+// into bands that are processed in parallel, and the inner loops use SSE4.1
+// or AVX2 when the CPU supports them (checked at runtime). Only one row
+// buffer per band is needed, so memory usage doesn't depend on the source
+// size.
+//
+// Images are processed as 32-bit (premultiplied if they have an alpha
+// channel) and the output is in that format.
+namespace resampler {
+
+	enum Filter {
+		// Box for large reduction factors (where it's both faster and as
+		// good), Lanczos3 otherwise
+		Auto,
+		// Area average when downscaling, nearest neighbour when upscaling
+		Box,
+		Lanczos3
+	};
+
+	enum InstructionSet {
+		Generic,
+		Sse41,
+		Avx2
+	};
+
+	QImage scaled(const QImage& image, const QSize& size, Qt::AspectRatioMode aspectRatioMode = Qt::IgnoreAspectRatio, Filter filter = Auto);
+	InstructionSet supportedInstructionSet();
+	void setInstructionSet(InstructionSet v);
+	QString instructionSet();
+
+}
+
+}
+
+#endif // MV_RESAMPLER_H
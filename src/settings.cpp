@@ -17,6 +17,16 @@ QVariant Settings::value(const QString & key, const QVariant & defaultValue) con
 	if (key == "undoSize" && v.isNull()) return QVariant(10);
 	if (key == "showStatusBar" && v.isNull()) return QVariant(false);
 	if (key == "showToolbar" && v.isNull()) return QVariant(true);
+	if (key == "showPerformanceStatus" && v.isNull()) return QVariant(false);
+	if (key == "imageCacheSize" && v.isNull()) return QVariant(512); // In MB
+	if (key == "prefetchAhead" && v.isNull()) return QVariant(3);
+	if (key == "prefetchBehind" && v.isNull()) return QVariant(1);
+	if (key == "prefetchMaxAhead" && v.isNull()) return QVariant(16); // When navigating fast
+	if (key == "tileCacheSize" && v.isNull()) return QVariant(256); // In MB
+	if (key == "useThumbnailCache" && v.isNull()) return QVariant(true);
+	if (key == "tiledRenderingThreshold" && v.isNull()) return QVariant(100); // In megapixels
+	if (key == "sortMode" && v.isNull()) return QVariant(0); // DirectoryModel::SortMode
+	if (key == "duplicateThreshold" && v.isNull()) return QVariant(10); // Hamming distance, out of 64 bits
 	return v;
 }
 
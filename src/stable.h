@@ -1,39 +1,52 @@
 // Add C includes here
+#include <climits>
 #include <cmath>
 
 // Add C++ includes here
 #if defined __cplusplus
 #include <FreeImage.h>
 
+#include <algorithm>
+#include <list>
 #include <map>
 #include <math.h>
 #include <vector>
 
 #include <QAction>
 #include <QApplication>
+#include <QAtomicInt>
+#include <QBuffer>
 #include <QByteArray>
 #include <QCache>
 #include <QCheckBox>
 #include <QComboBox>
 #include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
+#include <QDesktopWidget>
 #include <QDialog>
 #include <QDialogButtonBox>
 #include <QDir>
+#include <QDirIterator>
 #include <QDragEnterEvent>
 #include <QDragMoveEvent>
 #include <QDropEvent>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFileOpenEvent>
 #include <QFileSystemWatcher>
 #include <QFontDatabase>
 #include <QFormLayout>
+#include <QGraphicsObject>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsRectItem>
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QImage>
+#include <QImageReader>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -50,29 +63,43 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QObject>
+#include <QPainter>
 #include <QPixmap>
 #include <QPlainTextEdit>
 #include <QPluginLoader>
 #include <QProcess>
 #include <QProgressBar>
 #include <QPushButton>
+#include <QQueue>
 #include <QRect>
+#include <QRunnable>
+#include <QSaveFile>
 #include <QScriptEngine>
 #include <QScriptValue>
 #include <QScriptValueIterator>
 #include <QScrollBar>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QSet>
 #include <QSettings>
 #include <QShowEvent>
 #include <QSpinBox>
 #include <QSplitter>
+#include <QStandardPaths>
 #include <QStatusBar>
+#include <QStyleOptionGraphicsItem>
 #include <QString>
 #include <QStringList>
 #include <QTimer>
 #include <QThread>
+#include <QThreadPool>
+#include <QtEndian>
 #include <QToolBar>
+#include <QTransform>
 #include <QUrl>
 #include <QVariant>
 #include <QVBoxLayout>
+#include <QVector>
+#include <QWaitCondition>
 #include <QWidget>
 #endif // __cplusplus
\ No newline at end of file
@@ -25,63 +25,100 @@ int compareVersions(const QString& v1, const QString& v2) {
 	return 0;
 }
 
-bool NaturalSortCompare::operator() (const QString& s1, const QString& s2) {
-	if (s1 == "" || s2 == "") return s1 < s2;
-
-	// Move to the first difference between the strings
-	int startIndex = -1;
-	int length = s1.length() > s2.length() ? s2.length() : s1.length();
-	for (int i = 0; i < length; i++) {
-		QChar c1 = s1[i];
-		QChar c2 = s2[i];
-		if (c1 != c2) {
-			startIndex = i;
-			break;
-		}
-	}
+namespace {
+
+// Code units are written big-endian so that keys compare like the strings.
+// 0xFFFF (a non-character) is reserved for the start of numbers.
+void appendCodeUnit(QByteArray& key, ushort c) {
+	if (c == 0xFFFF) c = 0xFFFE;
+	key.append((char)(c >> 8));
+	key.append((char)(c & 0xFF));
+}
 
-	// If the strings are the same, exit now.
-	if (startIndex < 0) return s1 < s2;
-
-	// Now extract the numbers, if any, from the two strings.
-	QString sn1;
-	QString sn2;
-	bool done1 = false;
-	bool done2 = false;
-	length = s1.length() < s2.length() ? s2.length() : s1.length();
-
-	for (int i = startIndex; i < length; i++) {
-		if (!done1 && i < s1.length()) {
-			if (isNumber(s1[i])) {
-				sn1 += QString(s1[i]);
-			} else {
-				done1 = true;
-			}
-		}
+struct SortKey {
+	QByteArray key;
+	int index;
+	bool operator<(const SortKey& other) const { return key < other.key; }
+};
+
+}
 
-		if (!done2 && i < s2.length()) {
-			if (isNumber(s2[i])) {
-				sn2 += QString(s2[i]);
-			} else {
-				done2 = true;
-			}
+// Text is copied as is, while each run of digits is replaced by:
+//
+// - a 0xFFFF marker, so that numbers sort after any other character (eg.
+//   "example.bin" is before "example1.bin"),
+// - the number of significant digits, on two bytes, so that longer numbers
+//   sort after shorter ones,
+// - the significant digits themselves.
+//
+// The number of leading zeros of each number is then appended at the end,
+// after a null code unit, so that "1" and "01" are not equal but the zeros
+// only decide between names that are otherwise equal (eg. "01a" is before
+// "1b"). The null code unit sorts before any text, so that the shorter of
+// two names that start the same is first.
+//
+// Numbers are therefore compared by value whatever their length, and two
+// keys compare like the natural order of their strings with a plain byte
+// comparison.
+QByteArray naturalSortKey(const QString& s) {
+	QByteArray output;
+	QByteArray zeroCounts;
+	output.reserve(s.length() * 2 + 8);
+
+	const ushort* c = s.utf16();
+	int length = s.length();
+	int i = 0;
+
+	while (i < length) {
+		if (c[i] < '0' || c[i] > '9') {
+			appendCodeUnit(output, c[i]);
+			i++;
+			continue;
 		}
 
-		if (done1 && done2) break;
+		int start = i;
+		while (i < length && c[i] >= '0' && c[i] <= '9') i++;
+
+		// At least one digit is kept, so that zero is "0"
+		int significantStart = start;
+		while (significantStart < i - 1 && c[significantStart] == '0') significantStart++;
+		int digitCount = qMin(i - significantStart, 0xFFFF);
+		int zeroCount = qMin(significantStart - start, 0xFF);
+
+		output.append((char)0xFF);
+		output.append((char)0xFF);
+		output.append((char)(digitCount >> 8));
+		output.append((char)(digitCount & 0xFF));
+		for (int j = 0; j < digitCount; j++) output.append((char)c[significantStart + j]);
+		zeroCounts.append((char)zeroCount);
 	}
 
-	// If none of the string contain a number, use a regular comparison.
-	if (sn1 == "" && sn2 == "") return s1 < s2;
+	output.append((char)0);
+	output.append((char)0);
+	output.append(zeroCounts);
+	return output;
+}
 
-	// If one of the strings doesn't contain a number at that position,
-	// we put the string without number first so that, for example,
-	// "example.bin" is before "example1.bin"
-	if (sn1 == "" && sn2 != "") return true;
-	if (sn1 != "" && sn2 == "") return false;
+// The keys are computed once for each string, so sorting doesn't do more
+// than byte comparisons.
+void naturalSort(QStringList& strings) {
+	std::vector<SortKey> keys(strings.size());
+	for (int i = 0; i < strings.size(); i++) {
+		keys[i].key = naturalSortKey(strings[i]);
+		keys[i].index = i;
+	}
 
-	return sn1.toInt() < sn2.toInt();
+	std::sort(keys.begin(), keys.end());
+
+	QStringList output;
+	output.reserve(strings.size());
+	for (int i = 0; i < (int)keys.size(); i++) output.append(strings[keys[i].index]);
+	strings = output;
 }
 
+bool NaturalSortCompare::operator() (const QString& s1, const QString& s2) const {
+	return naturalSortKey(s1) < naturalSortKey(s2);
+}
 
 }
 } // stringutil
@@ -7,9 +7,20 @@ namespace stringutil {
 
 	int compareVersions(const QString& v1, const QString& v2);
 
+	// Collation key of a string in natural order (where "file2" is before
+	// "file10"). Keys are compared as bytes.
+	QByteArray naturalSortKey(const QString& s);
+
+	// Sorts the strings in natural order. Use this rather than
+	// NaturalSortCompare to sort lists, since the keys are only computed once
+	// per string.
+	void naturalSort(QStringList& strings);
+
+	// Compares two strings in natural order. Only meant for occasional
+	// comparisons (eg. a binary search), since it computes both keys each
+	// time.
 	struct NaturalSortCompare {
-		inline bool isNumber(QChar c) { return c >= '0' && c <= '9'; }
-		bool operator() (const QString& s1, const QString& s2);
+		bool operator() (const QString& s1, const QString& s2) const;
 	};
 
 } // stringutil
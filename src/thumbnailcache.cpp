@@ -0,0 +1,134 @@
+#include "constants.h"
+#include "resampler.h"
+#include "thumbnailcache.h"
+
+namespace mv {
+namespace thumbnailCache {
+
+namespace {
+
+QString tierName(int tier) {
+	return tier == XLarge ? "x-large" : "large";
+}
+
+QString fileUri(const QString& filePath) {
+	return QUrl::fromLocalFile(QFileInfo(filePath).absoluteFilePath()).toString(QUrl::FullyEncoded);
+}
+
+QString fileMTime(const QFileInfo& fileInfo) {
+	return QString::number(fileInfo.lastModified().toMSecsSinceEpoch() / 1000);
+}
+
+bool isValid(const QString& thumbnailMTime, const QString& thumbnailSize, const QFileInfo& fileInfo) {
+	if (thumbnailMTime != fileMTime(fileInfo)) return false;
+	// Thumb::Size is optional
+	if (thumbnailSize != "" && thumbnailSize != QString::number(fileInfo.size())) return false;
+	return true;
+}
+
+QImage loadThumbnail(const QString& thumbnailPath, const QFileInfo& fileInfo, QSize* sourceSize) {
+	QFile file(thumbnailPath);
+	if (!file.open(QIODevice::ReadOnly)) return QImage();
+
+	qint64 fileSize = file.size();
+	if (fileSize <= 0) return QImage();
+
+	// Map the file rather than reading it into a buffer first
+	uchar* data = file.map(0, fileSize);
+	if (!data) return QImage();
+	QImage image = QImage::fromData(data, (int)fileSize, "PNG");
+	file.unmap(data);
+
+	if (image.isNull()) return QImage();
+	if (!isValid(image.text("Thumb::MTime"), image.text("Thumb::Size"), fileInfo)) return QImage();
+
+	if (sourceSize) {
+		int width = image.text("Thumb::Image::Width").toInt();
+		int height = image.text("Thumb::Image::Height").toInt();
+		*sourceSize = width > 0 && height > 0 ? QSize(width, height) : QSize();
+	}
+
+	return image;
+}
+
+bool saveThumbnail(const QString& filePath, const QFileInfo& fileInfo, const QImage& image, const QSize& sourceSize, int tier) {
+	QString path = thumbnailPath(filePath, tier);
+
+	QDir dir(QFileInfo(path).absolutePath());
+	if (!dir.exists()) {
+		if (!dir.mkpath(".")) return false;
+		QFile::setPermissions(dir.absolutePath(), QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+	}
+
+	QImage thumbnail = image;
+	if (image.width() > tier || image.height() > tier) thumbnail = resampler::scaled(image, QSize(tier, tier), Qt::KeepAspectRatio);
+
+	thumbnail.setText("Thumb::URI", fileUri(filePath));
+	thumbnail.setText("Thumb::MTime", fileMTime(fileInfo));
+	thumbnail.setText("Thumb::Size", QString::number(fileInfo.size()));
+	thumbnail.setText("Thumb::Image::Width", QString::number(sourceSize.width()));
+	thumbnail.setText("Thumb::Image::Height", QString::number(sourceSize.height()));
+	thumbnail.setText("Software", APPLICATION_TITLE);
+
+	// The spec requires thumbnails to be written atomically and to be only
+	// readable by the owner.
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly)) return false;
+	file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+	if (!thumbnail.save(&file, "PNG")) {
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
+
+}
+
+QString folderPath() {
+	return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/thumbnails";
+}
+
+QString thumbnailPath(const QString& filePath, int tier) {
+	QByteArray hash = QCryptographicHash::hash(fileUri(filePath).toUtf8(), QCryptographicHash::Md5);
+	return QString("%1/%2/%3.png").arg(folderPath()).arg(tierName(tier)).arg(QString(hash.toHex()));
+}
+
+// Returns the largest valid thumbnail of the file, or a null image if
+// there isn't any. The original file is only stat'ed, not read.
+QImage load(const QString& filePath, QSize* sourceSize) {
+	QFileInfo fileInfo(filePath);
+	if (!fileInfo.exists()) return QImage();
+
+	QImage output = loadThumbnail(thumbnailPath(filePath, XLarge), fileInfo, sourceSize);
+	if (output.isNull()) output = loadThumbnail(thumbnailPath(filePath, Large), fileInfo, sourceSize);
+	return output;
+}
+
+// Only reads the PNG text chunks, not the pixels.
+bool isUpToDate(const QString& filePath, int tier) {
+	QImageReader reader(thumbnailPath(filePath, tier), "PNG");
+	if (!reader.canRead()) return false;
+	return isValid(reader.text("Thumb::MTime"), reader.text("Thumb::Size"), QFileInfo(filePath));
+}
+
+// Creates the missing or outdated thumbnails of the file from an already
+// decoded image.
+void save(const QString& filePath, const QImage& image, const QSize& sourceSize) {
+	if (image.isNull()) return;
+
+	QFileInfo fileInfo(filePath);
+	if (!fileInfo.exists()) return;
+
+	// Don't create thumbnails of thumbnails
+	if (fileInfo.absoluteFilePath().startsWith(folderPath() + "/")) return;
+
+	int tiers[] = { XLarge, Large };
+	for (int i = 0; i < 2; i++) {
+		int tier = tiers[i];
+		if (isUpToDate(filePath, tier)) continue;
+		if (!saveThumbnail(filePath, fileInfo, image, sourceSize, tier)) qWarning() << "Could not save thumbnail of" << filePath << "to" << thumbnailPath(filePath, tier);
+	}
+}
+
+}
+}
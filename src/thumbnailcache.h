@@ -0,0 +1,29 @@
+#ifndef MV_THUMBNAILCACHE_H
+#define MV_THUMBNAILCACHE_H
+
+namespace mv {
+
+// Persistent thumbnail cache compatible with the freedesktop.org thumbnail
+// specification, so that thumbnails created by other applications (file
+// managers, other viewers) are reused and vice versa. Thumbnails are PNG
+// files named after the MD5 of the file URI, and are only valid if their
+// Thumb::MTime (and Thumb::Size, if present) match the original file.
+//
+// Only the "large" (256px) and "x-large" (512px) tiers are used. All the
+// functions are thread-safe.
+namespace thumbnailCache {
+
+	const int Large = 256;
+	const int XLarge = 512;
+
+	QString folderPath();
+	QString thumbnailPath(const QString& filePath, int tier);
+	QImage load(const QString& filePath, QSize* sourceSize = NULL);
+	bool isUpToDate(const QString& filePath, int tier);
+	void save(const QString& filePath, const QImage& image, const QSize& sourceSize);
+
+}
+
+}
+
+#endif // MV_THUMBNAILCACHE_H
@@ -0,0 +1,168 @@
+#include "tiffreader.h"
+
+#include <tiffio.h>
+
+namespace mv {
+namespace tiffReader {
+
+namespace {
+
+// Strips are decoded whole, so files made of very large strips (eg. a
+// single strip for the whole image) can't be read in a bounded amount of
+// memory, and are left to QImageReader.
+const qint64 MaxChunkBytes = 64 * 1024 * 1024;
+
+// Tiles or strips, which are the units libtiff decodes
+struct Layout {
+	bool tiled;
+	quint32 width;
+	quint32 height;
+	quint32 chunkWidth;
+	quint32 chunkHeight;
+};
+
+TIFF* openFile(const QString& filePath) {
+	return TIFFOpen(QFile::encodeName(filePath).constData(), "r");
+}
+
+bool readLayout(TIFF* tiff, Layout* output) {
+	output->width = 0;
+	output->height = 0;
+	output->chunkWidth = 0;
+	output->chunkHeight = 0;
+	output->tiled = TIFFIsTiled(tiff) != 0;
+
+	if (!TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &output->width)) return false;
+	if (!TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &output->height)) return false;
+
+	if (output->tiled) {
+		if (!TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &output->chunkWidth)) return false;
+		if (!TIFFGetField(tiff, TIFFTAG_TILELENGTH, &output->chunkHeight)) return false;
+	} else {
+		output->chunkWidth = output->width;
+		if (!TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &output->chunkHeight)) return false;
+		output->chunkHeight = qMin(output->chunkHeight, output->height);
+	}
+
+	if (!output->width || !output->height || !output->chunkWidth || !output->chunkHeight) return false;
+	return (qint64)output->chunkWidth * (qint64)output->chunkHeight * 4 <= MaxChunkBytes;
+}
+
+}
+
+// Only checks the extension
+bool isTiff(const QString& filePath) {
+	QString suffix = QFileInfo(filePath).suffix().toLower();
+	return suffix == "tif" || suffix == "tiff";
+}
+
+// Whether the file is a TIFF whose regions can be read without decoding
+// much more than the region itself
+bool canReadRegions(const QString& filePath) {
+	if (!isTiff(filePath)) return false;
+
+	TIFF* tiff = openFile(filePath);
+	if (!tiff) return false;
+
+	Layout layout;
+	char error[1024];
+	bool output = readLayout(tiff, &layout) && TIFFRGBAImageOK(tiff, error);
+	TIFFClose(tiff);
+	return output;
+}
+
+// Returns a null image if the region couldn't be read, or if the request
+// has been canceled. The region is clipped to the image.
+QImage readRegion(const QString& filePath, const QRect& rect, int shift, QSharedPointer<QAtomicInt> canceled, QString* errorString) {
+	TIFF* tiff = openFile(filePath);
+	if (!tiff) {
+		if (errorString) *errorString = "Could not open file";
+		return QImage();
+	}
+
+	Layout layout;
+	if (!readLayout(tiff, &layout)) {
+		TIFFClose(tiff);
+		if (errorString) *errorString = "Unsupported layout";
+		return QImage();
+	}
+
+	QRect region = rect & QRect(0, 0, (int)layout.width, (int)layout.height);
+	if (region.isEmpty()) {
+		TIFFClose(tiff);
+		if (errorString) *errorString = "Region outside of the image";
+		return QImage();
+	}
+
+	int blockSize = 1 << shift;
+	int outputWidth = (region.width() + blockSize - 1) >> shift;
+	int outputHeight = (region.height() + blockSize - 1) >> shift;
+
+	// Sums of each channel of the source pixels covered by each output pixel
+	std::vector<quint64> sums((size_t)outputWidth * (size_t)outputHeight * 4, 0);
+	std::vector<quint32> raster((size_t)layout.chunkWidth * (size_t)layout.chunkHeight);
+
+	int chunkWidth = (int)layout.chunkWidth;
+	int chunkHeight = (int)layout.chunkHeight;
+	int firstChunkX = layout.tiled ? region.left() / chunkWidth * chunkWidth : 0;
+	int firstChunkY = region.top() / chunkHeight * chunkHeight;
+
+	for (int chunkY = firstChunkY; chunkY <= region.bottom(); chunkY += chunkHeight) {
+		for (int chunkX = firstChunkX; chunkX <= region.right(); chunkX += chunkWidth) {
+			if (canceled && canceled->load()) {
+				TIFFClose(tiff);
+				return QImage();
+			}
+
+			int ok = layout.tiled ? TIFFReadRGBATile(tiff, chunkX, chunkY, &raster[0]) : TIFFReadRGBAStrip(tiff, chunkY, &raster[0]);
+			if (!ok) {
+				TIFFClose(tiff);
+				if (errorString) *errorString = QString("Could not decode the %1 at %2, %3").arg(layout.tiled ? "tile" : "strip").arg(chunkX).arg(chunkY);
+				return QImage();
+			}
+
+			// The raster is bottom-up. Partial tiles are still laid out
+			// like full ones, whereas the last strip only has its own rows.
+			int rowCount = qMin(chunkHeight, (int)layout.height - chunkY);
+			int rasterHeight = layout.tiled ? chunkHeight : rowCount;
+
+			int x1 = qMax(chunkX, region.left());
+			int x2 = qMin(chunkX + chunkWidth - 1, region.right());
+			int y1 = qMax(chunkY, region.top());
+			int y2 = qMin(chunkY + rowCount - 1, region.bottom());
+
+			for (int y = y1; y <= y2; y++) {
+				const quint32* row = &raster[(size_t)(rasterHeight - 1 - (y - chunkY)) * (size_t)chunkWidth];
+				quint64* sumRow = &sums[(size_t)((y - region.top()) >> shift) * (size_t)outputWidth * 4];
+				for (int x = x1; x <= x2; x++) {
+					quint32 p = row[x - chunkX];
+					quint64* s = sumRow + (((x - region.left()) >> shift) << 2);
+					s[0] += TIFFGetR(p);
+					s[1] += TIFFGetG(p);
+					s[2] += TIFFGetB(p);
+					s[3] += TIFFGetA(p);
+				}
+			}
+		}
+	}
+
+	TIFFClose(tiff);
+
+	// Blocks on the right and bottom edges might be partial
+	QImage output(outputWidth, outputHeight, QImage::Format_ARGB32_Premultiplied);
+	for (int y = 0; y < outputHeight; y++) {
+		QRgb* outputRow = (QRgb*)output.scanLine(y);
+		const quint64* sumRow = &sums[(size_t)y * (size_t)outputWidth * 4];
+		quint64 blockHeight = qMin(blockSize, region.height() - (y << shift));
+		for (int x = 0; x < outputWidth; x++) {
+			quint64 count = blockHeight * (quint64)qMin(blockSize, region.width() - (x << shift));
+			const quint64* s = sumRow + x * 4;
+			outputRow[x] = qRgba((int)((s[0] + count / 2) / count), (int)((s[1] + count / 2) / count), (int)((s[2] + count / 2) / count), (int)((s[3] + count / 2) / count));
+		}
+	}
+
+	return output;
+}
+
+}
+}
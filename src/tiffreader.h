@@ -0,0 +1,26 @@
+#ifndef MV_TIFFREADER_H
+#define MV_TIFFREADER_H
+
+namespace mv {
+
+// Reads regions of TIFF files with libtiff, one tile or strip at a time, so
+// that only the tiles or strips covering the region are decoded and memory
+// usage depends on the size of the region rather than on the size of the
+// image. Qt's TIFF handler doesn't support clip rects, so it always decodes
+// the whole image.
+//
+// Regions can be read at a reduced resolution, in which case each output
+// pixel is the average of a block of 2^shift x 2^shift source pixels,
+// accumulated while the tiles or strips are decoded. Images are returned in
+// premultiplied ARGB. All the functions are thread-safe.
+namespace tiffReader {
+
+	bool isTiff(const QString& filePath);
+	bool canReadRegions(const QString& filePath);
+	QImage readRegion(const QString& filePath, const QRect& rect, int shift = 0, QSharedPointer<QAtomicInt> canceled = QSharedPointer<QAtomicInt>(), QString* errorString = NULL);
+
+}
+
+}
+
+#endif // MV_TIFFREADER_H
@@ -0,0 +1,402 @@
+#include "resampler.h"
+#include "tiffreader.h"
+#include "tiledimageitem.h"
+
+namespace mv {
+
+TileTask::TileTask(QObject* receiver, const QString& filePath, const QImage& image, const QString& key, const QRect& sourceRect, int level, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	receiver_ = receiver;
+	filePath_ = filePath;
+	image_ = image;
+	key_ = key;
+	sourceRect_ = sourceRect;
+	level_ = level;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void TileTask::run() {
+	if (canceled_->load()) return;
+
+	int blockSize = 1 << level_;
+	QSize tileSize((sourceRect_.width() + blockSize - 1) >> level_, (sourceRect_.height() + blockSize - 1) >> level_);
+
+	QImage image;
+	if (!image_.isNull()) {
+		image = image_.copy(sourceRect_);
+		if (tileSize != sourceRect_.size()) image = resampler::scaled(image, tileSize);
+	} else if (tiffReader::isTiff(filePath_)) {
+		QString error;
+		image = tiffReader::readRegion(filePath_, sourceRect_, level_, canceled_, &error);
+		if (image.isNull() && !canceled_->load()) qWarning() << "Could not decode tile" << key_ << "of" << filePath_ << ":" << error;
+	} else {
+		// The clip rect is applied first, then the result is scaled down to
+		// the size of the tile at the requested pyramid level.
+		QImageReader reader(filePath_);
+		reader.setClipRect(sourceRect_);
+		if (tileSize != sourceRect_.size()) reader.setScaledSize(tileSize);
+
+		image = reader.read();
+		if (image.isNull()) qWarning() << "Could not decode tile" << key_ << "of" << filePath_ << ":" << reader.errorString();
+	}
+
+	if (canceled_->load()) return;
+
+	QMetaObject::invokeMethod(receiver_, "tileTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(QString, key_), Q_ARG(QRect, sourceRect_), Q_ARG(QImage, image), Q_ARG(int, requestId_));
+}
+
+MagnifiedTileTask::MagnifiedTileTask(QObject* receiver, const QString& filePath, const QImage& image, const QString& key, const QRect& tileRect, qreal scale, int requestId, QSharedPointer<QAtomicInt> canceled) {
+	receiver_ = receiver;
+	filePath_ = filePath;
+	image_ = image;
+	key_ = key;
+	tileRect_ = tileRect;
+	scale_ = scale;
+	requestId_ = requestId;
+	canceled_ = canceled;
+}
+
+void MagnifiedTileTask::run() {
+	if (canceled_->load()) return;
+
+	// Source pixels covered by the tile, plus one pixel on each side for
+	// the bilinear filter.
+	QRectF exactSourceRect(tileRect_.x() / scale_, tileRect_.y() / scale_, tileRect_.width() / scale_, tileRect_.height() / scale_);
+	QRect imageRect = image_.isNull() ? QRect() : image_.rect();
+	QRect sourceRect = exactSourceRect.toAlignedRect().adjusted(-1, -1, 1, 1);
+
+	QImage source;
+	if (!image_.isNull()) {
+		sourceRect &= imageRect;
+		source = image_.copy(sourceRect);
+	} else {
+		QImageReader reader(filePath_);
+		sourceRect &= QRect(QPoint(0, 0), reader.size());
+
+		if (tiffReader::isTiff(filePath_)) {
+			QString error;
+			source = tiffReader::readRegion(filePath_, sourceRect, 0, canceled_, &error);
+			if (source.isNull() && !canceled_->load()) qWarning() << "Could not decode tile" << key_ << "of" << filePath_ << ":" << error;
+		} else {
+			reader.setClipRect(sourceRect);
+			source = reader.read();
+			if (source.isNull()) qWarning() << "Could not decode tile" << key_ << "of" << filePath_ << ":" << reader.errorString();
+		}
+	}
+
+	if (canceled_->load()) return;
+
+	QImage image;
+	if (!source.isNull()) {
+		image = QImage(tileRect_.size(), QImage::Format_ARGB32_Premultiplied);
+		image.fill(Qt::transparent);
+		QPainter painter(&image);
+		painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+		QTransform transform;
+		transform.translate(-tileRect_.x(), -tileRect_.y());
+		transform.scale(scale_, scale_);
+		painter.setTransform(transform);
+		painter.drawImage(sourceRect.topLeft(), source);
+		painter.end();
+	}
+
+	if (canceled_->load()) return;
+
+	QMetaObject::invokeMethod(receiver_, "tileTask_done", Qt::QueuedConnection, Q_ARG(QString, filePath_), Q_ARG(QString, key_), Q_ARG(QRect, exactSourceRect.toAlignedRect()), Q_ARG(QImage, image), Q_ARG(int, requestId_));
+}
+
+TiledImageItem::TiledImageItem(QGraphicsItem* parent) : QGraphicsObject(parent) {
+	canRenderSource_ = false;
+	imagePixmapKey_ = 0;
+	nextRequestId_ = 1;
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+	threadPool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+TiledImageItem::~TiledImageItem() {
+	cancelTilesExcept(QSet<QString>());
+	threadPool_.waitForDone();
+}
+
+void TiledImageItem::setSource(const QString& filePath, const QSize& sourceSize) {
+	if (source_ == filePath && sourceSize_ == sourceSize) return;
+
+	prepareGeometryChange();
+	clear();
+
+	source_ = filePath;
+	sourceSize_ = sourceSize;
+	image_ = QImage();
+	imagePixmapKey_ = 0;
+	placeholder_ = QPixmap();
+
+	// If the format doesn't support clip rects, QImageReader decodes the
+	// whole image for each tile, which is what this item is meant to avoid.
+	// Qt's TIFF handler doesn't, so TIFF files are read with libtiff.
+	canRenderSource_ = false;
+	if (source_ != "" && sourceSize_.isValid()) {
+		if (tiffReader::isTiff(source_)) {
+			canRenderSource_ = tiffReader::canReadRegions(source_);
+		} else {
+			QImageReader reader(source_);
+			canRenderSource_ = reader.supportsOption(QImageIOHandler::ClipRect);
+		}
+	}
+}
+
+QString TiledImageItem::source() const {
+	return source_;
+}
+
+bool TiledImageItem::canRenderSource() const {
+	return canRenderSource_ || !image_.isNull();
+}
+
+// Full resolution image of the source, if it's in memory, in which case
+// tiles are cut from it rather than decoded from the file. This doesn't
+// invalidate the tiles since their content is the same. The pixmap is only
+// converted once, not each time it's set.
+void TiledImageItem::setImage(const QPixmap& pixmap) {
+	if (pixmap.size() != sourceSize_) return;
+	if (imagePixmapKey_ == pixmap.cacheKey()) return;
+	image_ = pixmap.toImage();
+	imagePixmapKey_ = pixmap.cacheKey();
+}
+
+void TiledImageItem::setPlaceholder(const QPixmap& pixmap) {
+	if (placeholder_.cacheKey() == pixmap.cacheKey()) return;
+	placeholder_ = pixmap;
+	update();
+}
+
+void TiledImageItem::setCacheMaxBytes(qint64 v) {
+	tileCache_.setMaxBytes(v);
+}
+
+void TiledImageItem::clear() {
+	cancelTilesExcept(QSet<QString>());
+	tileCache_.clear();
+}
+
+QRectF TiledImageItem::boundingRect() const {
+	if (!sourceSize_.isValid()) return QRectF();
+	return QRectF(0, 0, sourceSize_.width(), sourceSize_.height());
+}
+
+// Number of levels in the pyramid. The last one fits in a single tile.
+int TiledImageItem::levelCount() const {
+	int side = qMax(sourceSize_.width(), sourceSize_.height());
+	int output = 1;
+	while (side > TileSize) {
+		side = (side + 1) / 2;
+		output++;
+	}
+	return output;
+}
+
+// Returns the smallest level whose resolution is at least `scale` (the
+// number of screen pixels per source pixel).
+int TiledImageItem::levelForScale(qreal scale) const {
+	if (scale >= 1 || scale <= 0) return 0;
+	int level = (int)floor(log(1.0 / scale) / log(2.0));
+	int maxLevel = levelCount() - 1;
+	return level > maxLevel ? maxLevel : level;
+}
+
+QRect TiledImageItem::tileSourceRect(int level, int x, int y) const {
+	int span = TileSize << level;
+	return QRect(x * span, y * span, span, span) & QRect(QPoint(0, 0), sourceSize_);
+}
+
+QString TiledImageItem::tileKey(int level, int x, int y) const {
+	return QString("%1:%2:%3").arg(level).arg(x).arg(y);
+}
+
+void TiledImageItem::requestTile(int level, int x, int y) {
+	QString key = tileKey(level, x, y);
+	if (requests_.contains(key)) return;
+
+	QRect sourceRect = tileSourceRect(level, x, y);
+	if (sourceRect.isEmpty()) return;
+
+	Request request;
+	request.id = nextRequestId_++;
+	request.canceled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	requests_.insert(key, request);
+
+	// Coarser tiles are cheaper and cover more of the view, so they are
+	// decoded first.
+	threadPool_.start(new TileTask(this, source_, image_, key, sourceRect, level, request.id, request.canceled), level);
+}
+
+QString TiledImageItem::magnifiedTileKey(int zoomKey, int x, int y) const {
+	return QString("m%1:%2:%3").arg(zoomKey).arg(x).arg(y);
+}
+
+void TiledImageItem::requestMagnifiedTile(const QString& key, const QRect& tileRect, qreal scale) {
+	if (requests_.contains(key)) return;
+
+	Request request;
+	request.id = nextRequestId_++;
+	request.canceled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+	requests_.insert(key, request);
+
+	threadPool_.start(new MagnifiedTileTask(this, source_, image_, key, tileRect, scale, request.id, request.canceled));
+}
+
+void TiledImageItem::cancelTilesExcept(const QSet<QString>& keys) {
+	QStringList toCancel;
+	for (QHash<QString, Request>::const_iterator it = requests_.begin(); it != requests_.end(); ++it) {
+		if (!keys.contains(it.key())) toCancel << it.key();
+	}
+
+	for (int i = 0; i < toCancel.size(); i++) {
+		requests_[toCancel[i]].canceled->store(1);
+		requests_.remove(toCancel[i]);
+	}
+}
+
+// Draws the part of a coarser tile that covers the given tile, to be used
+// as a placeholder while the tile is being decoded.
+bool TiledImageItem::drawCoarserTile(QPainter* painter, int level, int x, int y) {
+	QRect targetRect = tileSourceRect(level, x, y);
+
+	for (int l = level + 1; l < levelCount(); l++) {
+		int shift = l - level;
+		const QPixmap* tile = tileCache_.peek(tileKey(l, x >> shift, y >> shift));
+		if (!tile || tile->isNull()) continue;
+
+		QRect coarseRect = tileSourceRect(l, x >> shift, y >> shift);
+		qreal s = 1.0 / (qreal)(1 << l);
+		QRectF pixmapRect((targetRect.x() - coarseRect.x()) * s, (targetRect.y() - coarseRect.y()) * s, targetRect.width() * s, targetRect.height() * s);
+		painter->drawPixmap(QRectF(targetRect), *tile, pixmapRect);
+		return true;
+	}
+
+	return false;
+}
+
+void TiledImageItem::drawPlaceholder(QPainter* painter, const QRectF& sourceRect) {
+	if (placeholder_.isNull() || !sourceSize_.isValid()) return;
+	qreal s = (qreal)placeholder_.width() / (qreal)sourceSize_.width();
+	painter->drawPixmap(sourceRect, placeholder_, QRectF(sourceRect.x() * s, sourceRect.y() * s, sourceRect.width() * s, sourceRect.height() * s));
+}
+
+// Tiles are in magnified image coordinates, anchored to the item origin, and
+// are drawn without any transformation. The zoom is part of the tile keys
+// so that tiles of other zoom levels remain cached.
+void TiledImageItem::paintMagnified(QPainter* painter, const QRectF& exposedRect, const QRectF& visibleRect, qreal scale) {
+	int zoomKey = qRound(scale * 1000.0);
+	QRectF magnifiedExposedRect(exposedRect.x() * scale, exposedRect.y() * scale, exposedRect.width() * scale, exposedRect.height() * scale);
+	QRectF magnifiedVisibleRect(visibleRect.x() * scale, visibleRect.y() * scale, visibleRect.width() * scale, visibleRect.height() * scale);
+	QRect magnifiedBounds = QRectF(0, 0, sourceSize_.width() * scale, sourceSize_.height() * scale).toAlignedRect();
+
+	int x1 = (int)floor(magnifiedVisibleRect.left() / TileSize);
+	int y1 = (int)floor(magnifiedVisibleRect.top() / TileSize);
+	int x2 = (int)floor((magnifiedVisibleRect.right() - 1) / TileSize);
+	int y2 = (int)floor((magnifiedVisibleRect.bottom() - 1) / TileSize);
+
+	QTransform worldTransform = painter->worldTransform();
+	QPoint origin = worldTransform.map(QPointF(0, 0)).toPoint();
+
+	QSet<QString> neededKeys;
+
+	// Tiles just outside of the view are rendered too, so that they're
+	// ready when scrolling.
+	for (int y = y1 - 1; y <= y2 + 1; y++) {
+		for (int x = x1 - 1; x <= x2 + 1; x++) {
+			QRect tileRect = QRect(x * TileSize, y * TileSize, TileSize, TileSize) & magnifiedBounds;
+			if (tileRect.isEmpty()) continue;
+
+			QString key = magnifiedTileKey(zoomKey, x, y);
+			bool visible = x >= x1 && x <= x2 && y >= y1 && y <= y2;
+			bool exposed = visible && magnifiedExposedRect.intersects(tileRect);
+			QPixmap* tile = visible ? tileCache_.object(key) : NULL;
+
+			if (tile) {
+				if (exposed && !tile->isNull()) {
+					painter->setWorldTransform(QTransform());
+					painter->drawPixmap(origin + tileRect.topLeft(), *tile);
+					painter->setWorldTransform(worldTransform);
+				}
+				continue;
+			}
+
+			if (!visible && tileCache_.contains(key)) continue;
+
+			neededKeys.insert(key);
+			requestMagnifiedTile(key, tileRect, scale);
+			if (exposed) drawPlaceholder(painter, QRectF(tileRect.x() / scale, tileRect.y() / scale, tileRect.width() / scale, tileRect.height() / scale));
+		}
+	}
+
+	cancelTilesExcept(neededKeys);
+}
+
+// Tiles are requested for the whole visible area, not just the exposed
+// one, since a finished tile only repaints its own area and would otherwise
+// cancel the other pending tiles.
+void TiledImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+	if (!canRenderSource()) return;
+
+	QRectF exposedRect = option->exposedRect & boundingRect();
+	if (exposedRect.isEmpty()) return;
+
+	QRectF visibleRect = exposedRect;
+	if (widget) visibleRect = painter->worldTransform().inverted().mapRect(QRectF(widget->rect())) & boundingRect();
+
+	qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
+	if (scale >= MagnificationThreshold && painter->worldTransform().type() <= QTransform::TxScale) {
+		paintMagnified(painter, exposedRect, visibleRect, scale);
+		return;
+	}
+
+	int level = levelForScale(scale);
+	int span = TileSize << level;
+
+	int x1 = (int)floor(visibleRect.left() / span);
+	int y1 = (int)floor(visibleRect.top() / span);
+	int x2 = (int)floor((visibleRect.right() - 1) / span);
+	int y2 = (int)floor((visibleRect.bottom() - 1) / span);
+
+	painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+
+	QSet<QString> visibleKeys;
+
+	for (int y = y1; y <= y2; y++) {
+		for (int x = x1; x <= x2; x++) {
+			QString key = tileKey(level, x, y);
+			bool exposed = exposedRect.intersects(QRectF(tileSourceRect(level, x, y)));
+			QPixmap* tile = tileCache_.object(key);
+			if (tile) {
+				if (exposed && !tile->isNull()) painter->drawPixmap(QRectF(tileSourceRect(level, x, y)), *tile, QRectF(tile->rect()));
+				continue;
+			}
+
+			visibleKeys.insert(key);
+			requestTile(level, x, y);
+			if (exposed && !drawCoarserTile(painter, level, x, y)) drawPlaceholder(painter, QRectF(tileSourceRect(level, x, y)));
+		}
+	}
+
+	// Tiles that have been scrolled out of view, or that belong to another
+	// level, are no longer needed.
+	cancelTilesExcept(visibleKeys);
+}
+
+void TiledImageItem::tileTask_done(const QString& filePath, const QString& key, const QRect& sourceRect, const QImage& image, int requestId) {
+	if (filePath != source_) return;
+	if (!requests_.contains(key) || requests_[key].id != requestId) return;
+	requests_.remove(key);
+
+	// Tiles that couldn't be decoded (eg. while the file is being written)
+	// are not cached, so that they are requested again on the next paint.
+	// Repainting now would just request them again straight away.
+	if (image.isNull()) return;
+
+	tileCache_.insert(key, QPixmap::fromImage(image));
+	update(QRectF(sourceRect));
+}
+
+}
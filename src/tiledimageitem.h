@@ -0,0 +1,128 @@
+#ifndef MV_TILEDIMAGEITEM_H
+#define MV_TILEDIMAGEITEM_H
+
+#include "imagecache.h"
+
+namespace mv {
+
+class TileTask : public QRunnable {
+
+public:
+
+	TileTask(QObject* receiver, const QString& filePath, const QImage& image, const QString& key, const QRect& sourceRect, int level, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	QObject* receiver_;
+	QString filePath_;
+	QImage image_;
+	QString key_;
+	QRect sourceRect_;
+	int level_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Renders a tile of the image magnified at the given scale. The tile rect
+// is in magnified image coordinates (ie. source coordinates multiplied by
+// the scale) so that adjacent tiles line up exactly.
+class MagnifiedTileTask : public QRunnable {
+
+public:
+
+	MagnifiedTileTask(QObject* receiver, const QString& filePath, const QImage& image, const QString& key, const QRect& tileRect, qreal scale, int requestId, QSharedPointer<QAtomicInt> canceled);
+	void run();
+
+private:
+
+	QObject* receiver_;
+	QString filePath_;
+	QImage image_;
+	QString key_;
+	QRect tileRect_;
+	qreal scale_;
+	int requestId_;
+	QSharedPointer<QAtomicInt> canceled_;
+
+};
+
+// Graphics item that displays an image too large to be decoded in one go.
+// The image is split into fixed-size tiles at several pyramid levels (level
+// 0 is the full resolution, level 1 half of it, etc.) and only the tiles
+// that cover the exposed area, at the level matching the current zoom, are
+// decoded. Memory usage is therefore bounded by the tile cache rather than
+// by the image size.
+//
+// The item is in source image coordinates, so its bounding rect is the size
+// of the original image. Tiles are decoded with QImageReader clip rects,
+// which only saves memory for formats that support them natively (eg. JPEG)
+// - see canRenderSource() - or with tiffReader for TIFF files, or cut from
+// the full resolution image if it's already in memory (see setImage()).
+//
+// When the item is magnified by MagnificationThreshold or more (and not
+// rotated), tiles are instead rendered at the exact zoom level, in device
+// pixels, for the visible area plus a margin of one tile. Scrolling then
+// only blits already rendered tiles rather than transforming the image.
+// Missing tiles are drawn from the placeholder pixmap, if any.
+class TiledImageItem : public QGraphicsObject {
+
+	Q_OBJECT
+
+public:
+
+	static const int TileSize = 512;
+	static const int MagnificationThreshold = 2;
+
+	TiledImageItem(QGraphicsItem* parent = 0);
+	~TiledImageItem();
+	void setSource(const QString& filePath, const QSize& sourceSize);
+	QString source() const;
+	bool canRenderSource() const;
+	void setImage(const QPixmap& pixmap);
+	void setPlaceholder(const QPixmap& pixmap);
+	void setCacheMaxBytes(qint64 v);
+	void clear();
+	QRectF boundingRect() const;
+	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = 0);
+
+private:
+
+	struct Request {
+		int id;
+		QSharedPointer<QAtomicInt> canceled;
+	};
+
+	int levelCount() const;
+	int levelForScale(qreal scale) const;
+	QRect tileSourceRect(int level, int x, int y) const;
+	QString tileKey(int level, int x, int y) const;
+	bool drawCoarserTile(QPainter* painter, int level, int x, int y);
+	void drawPlaceholder(QPainter* painter, const QRectF& sourceRect);
+	void requestTile(int level, int x, int y);
+	void paintMagnified(QPainter* painter, const QRectF& exposedRect, const QRectF& visibleRect, qreal scale);
+	QString magnifiedTileKey(int zoomKey, int x, int y) const;
+	void requestMagnifiedTile(const QString& key, const QRect& tileRect, qreal scale);
+	void cancelTilesExcept(const QSet<QString>& keys);
+
+	QString source_;
+	QSize sourceSize_;
+	bool canRenderSource_;
+	QImage image_;
+	qint64 imagePixmapKey_;
+	QPixmap placeholder_;
+	ImageCache tileCache_;
+	QThreadPool threadPool_;
+	QHash<QString, Request> requests_;
+	int nextRequestId_;
+
+public slots:
+
+	void tileTask_done(const QString& filePath, const QString& key, const QRect& sourceRect, const QImage& image, int requestId);
+
+};
+
+}
+
+#endif // MV_TILEDIMAGEITEM_H
@@ -0,0 +1,372 @@
+#include "ziparchive.h"
+
+#include <zlib.h>
+
+namespace mv {
+
+namespace {
+
+const quint32 LocalHeaderSignature = 0x04034b50;
+const quint32 CentralHeaderSignature = 0x02014b50;
+const quint32 EndOfCentralDirectorySignature = 0x06054b50;
+const quint32 Zip64EndOfCentralDirectorySignature = 0x06064b50;
+const quint32 Zip64LocatorSignature = 0x07064b50;
+
+const int LocalHeaderSize = 30;
+const int CentralHeaderSize = 46;
+const int EndOfCentralDirectorySize = 22;
+const int Zip64EndOfCentralDirectorySize = 56;
+const int Zip64LocatorSize = 20;
+const int MaxCommentSize = 0xFFFF;
+
+const quint16 EncryptedFlag = 0x0001;
+const quint16 Utf8Flag = 0x0800;
+const quint16 StoredMethod = 0;
+const quint16 DeflatedMethod = 8;
+
+// Entries are decompressed in memory, so larger ones are not read
+const quint64 MaxEntrySize = 1024 * 1024 * 1024;
+
+const int MaxCachedArchives = 4;
+QMutex cacheMutex;
+QWaitCondition cacheCondition;
+// Most recently used first
+QList<QSharedPointer<ZipArchive> > cache;
+// Archives whose central directory is being parsed, which is done without
+// holding the lock
+QSet<QString> loadingPaths;
+
+quint16 readUInt16(const char* data) {
+	return qFromLittleEndian<quint16>((const uchar*)data);
+}
+
+quint32 readUInt32(const char* data) {
+	return qFromLittleEndian<quint32>((const uchar*)data);
+}
+
+quint64 readUInt64(const char* data) {
+	return qFromLittleEndian<quint64>((const uchar*)data);
+}
+
+QDateTime fromDosDateTime(quint16 date, quint16 time) {
+	QDate d(1980 + (date >> 9), (date >> 5) & 0x0F, date & 0x1F);
+	QTime t(time >> 11, (time >> 5) & 0x3F, (time & 0x1F) * 2);
+	return QDateTime(d, t);
+}
+
+bool readAt(QFile& file, qint64 offset, qint64 size, QByteArray* output) {
+	if (offset < 0 || size < 0 || offset + size > file.size()) return false;
+	if (!file.seek(offset)) return false;
+	*output = file.read(size);
+	return output->size() == size;
+}
+
+}
+
+// Only checks the extension, and that the path is a file
+bool ZipArchive::isArchive(const QString& filePath) {
+	QString suffix = QFileInfo(filePath).suffix().toLower();
+	if (suffix != "zip" && suffix != "cbz") return false;
+	return QFileInfo(filePath).isFile();
+}
+
+// Splits a virtual path into the path of the archive and the name of the
+// entry. Returns false if the path is not inside an archive, which is
+// checked without accessing the disk for most paths.
+bool ZipArchive::splitPath(const QString& filePath, QString* archivePath, QString* entryName) {
+	QString path = QDir::fromNativeSeparators(filePath);
+	QString lowerPath = path.toLower();
+
+	int index = 0;
+	while (true) {
+		int zipIndex = lowerPath.indexOf(".zip/", index);
+		int cbzIndex = lowerPath.indexOf(".cbz/", index);
+		if (zipIndex < 0 && cbzIndex < 0) return false;
+		if (zipIndex < 0 || (cbzIndex >= 0 && cbzIndex < zipIndex)) zipIndex = cbzIndex;
+
+		// Folders can also have a ".zip" extension
+		QString candidate = path.left(zipIndex + 4);
+		if (QFileInfo(candidate).isFile()) {
+			if (archivePath) *archivePath = QFileInfo(candidate).absoluteFilePath();
+			if (entryName) *entryName = path.mid(zipIndex + 5);
+			return true;
+		}
+
+		index = zipIndex + 5;
+	}
+}
+
+bool ZipArchive::isArchiveEntry(const QString& filePath) {
+	return splitPath(filePath, NULL, NULL);
+}
+
+// Returns a null pointer if the archive can't be read
+QSharedPointer<ZipArchive> ZipArchive::open(const QString& filePath, QString* errorString) {
+	QFileInfo fileInfo(filePath);
+	QString path = fileInfo.absoluteFilePath();
+	qint64 fileSize = fileInfo.size();
+	qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+	QMutexLocker locker(&cacheMutex);
+
+	// A large central directory is not parsed by several threads at once:
+	// the others wait for the result instead. Other archives can still be
+	// opened in the meantime.
+	while (loadingPaths.contains(path)) cacheCondition.wait(&cacheMutex);
+
+	for (int i = 0; i < cache.size(); i++) {
+		QSharedPointer<ZipArchive> archive = cache[i];
+		if (archive->filePath_ != path) continue;
+		cache.removeAt(i);
+		if (archive->fileSize_ != fileSize || archive->lastModified_ != lastModified) break;
+		cache.prepend(archive);
+		return archive;
+	}
+
+	loadingPaths.insert(path);
+	locker.unlock();
+
+	QSharedPointer<ZipArchive> archive(new ZipArchive(path));
+	archive->fileSize_ = fileSize;
+	archive->lastModified_ = lastModified;
+	bool loaded = archive->load(errorString);
+
+	locker.relock();
+	loadingPaths.remove(path);
+	cacheCondition.wakeAll();
+	if (!loaded) return QSharedPointer<ZipArchive>();
+
+	cache.prepend(archive);
+	while (cache.size() > MaxCachedArchives) cache.removeLast();
+	return archive;
+}
+
+// Reads the file at the given virtual path
+QByteArray ZipArchive::readFile(const QString& filePath, QString* errorString) {
+	QString archivePath;
+	QString entryName;
+	if (!splitPath(filePath, &archivePath, &entryName)) {
+		if (errorString) *errorString = "Not in an archive";
+		return QByteArray();
+	}
+
+	QSharedPointer<ZipArchive> archive = open(archivePath, errorString);
+	if (!archive) return QByteArray();
+	return archive->read(entryName, errorString);
+}
+
+ZipArchive::ZipArchive(const QString& filePath) {
+	filePath_ = filePath;
+	fileSize_ = 0;
+	lastModified_ = 0;
+}
+
+QString ZipArchive::filePath() const {
+	return filePath_;
+}
+
+// Names of the entries that can be read, in the order of the archive.
+// Folders are not included, nor are names with "." or ".." components, which
+// would change once made part of an absolute path.
+QStringList ZipArchive::fileNames() const {
+	QStringList output;
+	for (int i = 0; i < entries_.size(); i++) {
+		const Entry& entry = entries_[i];
+		if (entry.name.endsWith('/') || (entry.flags & EncryptedFlag)) continue;
+		if (entry.name.startsWith('/') || QDir::cleanPath(entry.name) != entry.name) continue;
+		output.append(entry.name);
+	}
+	return output;
+}
+
+bool ZipArchive::entry(const QString& name, Entry* entry) const {
+	int index = indexes_.value(name, -1);
+	if (index < 0) return false;
+	*entry = entries_[index];
+	return true;
+}
+
+// Reads and decompresses an entry. Only the entry itself is read from the
+// archive.
+QByteArray ZipArchive::read(const QString& name, QString* errorString) const {
+	QString error;
+	QByteArray output;
+
+	Entry entry;
+	QFile file(filePath_);
+	QByteArray header;
+	QByteArray data;
+
+	if (!this->entry(name, &entry)) {
+		error = "No such entry";
+	} else if (entry.flags & EncryptedFlag) {
+		error = "Encrypted entries are not supported";
+	} else if (entry.method != StoredMethod && entry.method != DeflatedMethod) {
+		error = QString("Unsupported compression method: %1").arg(entry.method);
+	} else if (entry.size > MaxEntrySize || entry.compressedSize > MaxEntrySize) {
+		error = "Entry is too large";
+	} else if (!file.open(QIODevice::ReadOnly)) {
+		error = file.errorString();
+	} else if (!readAt(file, entry.localHeaderOffset, LocalHeaderSize, &header) || readUInt32(header.constData()) != LocalHeaderSignature) {
+		error = "Invalid local header";
+	} else {
+		// The name and extra field lengths can differ from the central
+		// directory ones
+		qint64 dataOffset = entry.localHeaderOffset + LocalHeaderSize + readUInt16(header.constData() + 26) + readUInt16(header.constData() + 28);
+		if (!readAt(file, dataOffset, entry.compressedSize, &data)) error = "Truncated entry";
+	}
+
+	if (error == "" && entry.method == StoredMethod) {
+		output = data;
+	} else if (error == "" && entry.size > 0) {
+		output.resize((int)entry.size);
+
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		// Negative window bits for raw deflate data, without zlib header
+		if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+			error = "Could not initialize zlib";
+		} else {
+			stream.next_in = (Bytef*)data.data();
+			stream.avail_in = (uInt)data.size();
+			stream.next_out = (Bytef*)output.data();
+			stream.avail_out = (uInt)output.size();
+			int result = inflate(&stream, Z_FINISH);
+			if (result != Z_STREAM_END || stream.total_out != entry.size) error = "Invalid compressed data";
+			inflateEnd(&stream);
+		}
+	}
+
+	if (error == "" && crc32(0, (const Bytef*)output.constData(), (uInt)output.size()) != entry.crc) error = "CRC mismatch";
+
+	if (error != "") {
+		if (errorString) *errorString = error;
+		return QByteArray();
+	}
+
+	return output;
+}
+
+bool ZipArchive::load(QString* errorString) {
+	QFile file(filePath_);
+	if (!file.open(QIODevice::ReadOnly)) {
+		if (errorString) *errorString = file.errorString();
+		return false;
+	}
+
+	QString error;
+	qint64 fileSize = file.size();
+
+	// The end of central directory record is at the very end of the
+	// archive, unless there's a comment after it.
+	qint64 tailSize = qMin(fileSize, (qint64)(EndOfCentralDirectorySize + MaxCommentSize));
+	QByteArray tail;
+	if (!readAt(file, fileSize - tailSize, tailSize, &tail)) error = "Could not read end of archive";
+
+	int eocdIndex = -1;
+	for (int i = tail.size() - EndOfCentralDirectorySize; error == "" && i >= 0; i--) {
+		if (readUInt32(tail.constData() + i) == EndOfCentralDirectorySignature) {
+			eocdIndex = i;
+			break;
+		}
+	}
+	if (error == "" && eocdIndex < 0) error = "Not a ZIP archive";
+
+	quint64 entryCount = 0;
+	quint64 directorySize = 0;
+	quint64 directoryOffset = 0;
+
+	if (error == "") {
+		const char* eocd = tail.constData() + eocdIndex;
+		if (readUInt16(eocd + 4) != 0 || readUInt16(eocd + 6) != 0) error = "Multi-part archives are not supported";
+		entryCount = readUInt16(eocd + 10);
+		directorySize = readUInt32(eocd + 12);
+		directoryOffset = readUInt32(eocd + 16);
+
+		// ZIP64 archives have an additional record, pointed to by a locator
+		// just before the regular one
+		bool isZip64 = entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF;
+		qint64 locatorOffset = fileSize - tailSize + eocdIndex - Zip64LocatorSize;
+		QByteArray locator;
+		QByteArray record;
+		if (error == "" && isZip64) {
+			if (!readAt(file, locatorOffset, Zip64LocatorSize, &locator) || readUInt32(locator.constData()) != Zip64LocatorSignature) {
+				error = "Invalid ZIP64 locator";
+			} else if (!readAt(file, readUInt64(locator.constData() + 8), Zip64EndOfCentralDirectorySize, &record) || readUInt32(record.constData()) != Zip64EndOfCentralDirectorySignature) {
+				error = "Invalid ZIP64 end of central directory";
+			} else {
+				entryCount = readUInt64(record.constData() + 32);
+				directorySize = readUInt64(record.constData() + 40);
+				directoryOffset = readUInt64(record.constData() + 48);
+			}
+		}
+	}
+
+	QByteArray directory;
+	if (error == "" && (directorySize > MaxEntrySize || !readAt(file, directoryOffset, directorySize, &directory))) error = "Could not read central directory";
+
+	// The central directory is read in one go and parsed in memory
+	int offset = 0;
+	for (quint64 i = 0; error == "" && i < entryCount; i++) {
+		if (offset + CentralHeaderSize > directory.size() || readUInt32(directory.constData() + offset) != CentralHeaderSignature) {
+			error = "Invalid central directory";
+			break;
+		}
+
+		const char* header = directory.constData() + offset;
+		int nameSize = readUInt16(header + 28);
+		int extraSize = readUInt16(header + 30);
+		int commentSize = readUInt16(header + 32);
+		if (offset + CentralHeaderSize + nameSize + extraSize + commentSize > directory.size()) {
+			error = "Invalid central directory";
+			break;
+		}
+
+		Entry entry;
+		entry.flags = readUInt16(header + 8);
+		entry.method = readUInt16(header + 10);
+		entry.lastModified = fromDosDateTime(readUInt16(header + 14), readUInt16(header + 12));
+		entry.crc = readUInt32(header + 16);
+		entry.compressedSize = readUInt32(header + 20);
+		entry.size = readUInt32(header + 24);
+		entry.localHeaderOffset = readUInt32(header + 42);
+
+		// Names that are not flagged as UTF-8 are in the DOS code page,
+		// which is the same as Latin-1 for ASCII names.
+		QByteArray name(header + CentralHeaderSize, nameSize);
+		entry.name = (entry.flags & Utf8Flag) ? QString::fromUtf8(name) : QString::fromLatin1(name);
+		entry.name.replace('\\', '/');
+
+		// Sizes and offset that don't fit in 32 bits are in the ZIP64 extra
+		// field, in this order, and only if they are needed.
+		const char* extra = header + CentralHeaderSize + nameSize;
+		const char* extraEnd = extra + extraSize;
+		while (extra + 4 <= extraEnd) {
+			quint16 id = readUInt16(extra);
+			quint16 size = readUInt16(extra + 2);
+			const char* value = extra + 4;
+			const char* valueEnd = qMin(value + size, extraEnd);
+			if (id == 0x0001) {
+				if (entry.size == 0xFFFFFFFF && value + 8 <= valueEnd) { entry.size = readUInt64(value); value += 8; }
+				if (entry.compressedSize == 0xFFFFFFFF && value + 8 <= valueEnd) { entry.compressedSize = readUInt64(value); value += 8; }
+				if (entry.localHeaderOffset == 0xFFFFFFFF && value + 8 <= valueEnd) { entry.localHeaderOffset = readUInt64(value); value += 8; }
+				break;
+			}
+			extra += 4 + size;
+		}
+
+		indexes_.insert(entry.name, entries_.size());
+		entries_.append(entry);
+
+		offset += CentralHeaderSize + nameSize + extraSize + commentSize;
+	}
+
+	if (error != "") {
+		if (errorString) *errorString = error;
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef MV_ZIPARCHIVE_H
+#define MV_ZIPARCHIVE_H
+
+namespace mv {
+
+// Reads files from ZIP archives (including CBZ, which is the same format)
+// without extracting them. The central directory, at the end of the
+// archive, is read when the archive is opened and gives the position of
+// each entry, which can then be read directly. Entries can be stored or
+// deflated, and ZIP64 archives (needed past 4GB) are supported. Encrypted
+// entries and archives split over several files are not.
+//
+// Files in an archive are referred to with virtual paths made of the path
+// of the archive followed by the name of the entry, eg.
+// "/photos/delivery.zip/day1/IMG_0001.jpg". Archives are treated as a
+// single directory that contains all their entries, including those in
+// folders.
+//
+// Opened archives are cached, so that the central directory is only parsed
+// again if the archive changes. All the functions are thread-safe.
+class ZipArchive {
+
+public:
+
+	struct Entry {
+		QString name;
+		quint16 flags;
+		quint16 method;
+		quint32 crc;
+		quint64 compressedSize;
+		quint64 size;
+		quint64 localHeaderOffset;
+		QDateTime lastModified;
+	};
+
+	static bool isArchive(const QString& filePath);
+	static bool splitPath(const QString& filePath, QString* archivePath, QString* entryName);
+	static bool isArchiveEntry(const QString& filePath);
+	static QSharedPointer<ZipArchive> open(const QString& filePath, QString* errorString = NULL);
+	static QByteArray readFile(const QString& filePath, QString* errorString = NULL);
+
+	QString filePath() const;
+	QStringList fileNames() const;
+	bool entry(const QString& name, Entry* entry) const;
+	QByteArray read(const QString& name, QString* errorString = NULL) const;
+
+private:
+
+	ZipArchive(const QString& filePath);
+	bool load(QString* errorString);
+
+	QString filePath_;
+	qint64 fileSize_;
+	qint64 lastModified_;
+	QVector<Entry> entries_;
+	QHash<QString, int> indexes_;
+
+};
+
+}
+
+#endif // MV_ZIPARCHIVE_H
@@ -0,0 +1,446 @@
+#include <QtTest>
+
+#include "duplicatefinder.h"
+#include "resampler.h"
+#include "stringutil.h"
+
+using namespace mv;
+
+Q_DECLARE_METATYPE(mv::resampler::Filter)
+Q_DECLARE_METATYPE(mv::resampler::InstructionSet)
+
+namespace {
+
+// Random pixels, so that there's nothing for the caches or the branch
+// predictor to take advantage of
+QImage noiseImage(const QSize& size) {
+	QImage output(size, QImage::Format_RGB32);
+	quint32 seed = 12345;
+	for (int y = 0; y < size.height(); y++) {
+		QRgb* row = (QRgb*)output.scanLine(y);
+		for (int x = 0; x < size.width(); x++) {
+			seed = seed * 1664525u + 1013904223u;
+			row[x] = 0xff000000 | (seed >> 8);
+		}
+	}
+	return output;
+}
+
+// A gradient rather than noise, which would compress like no photo
+QImage photoImage(const QSize& size) {
+	QImage output(size, QImage::Format_RGB32);
+	for (int y = 0; y < size.height(); y++) {
+		QRgb* row = (QRgb*)output.scanLine(y);
+		for (int x = 0; x < size.width(); x++) row[x] = qRgb(x * 255 / size.width(), y * 255 / size.height(), (x ^ y) & 0xff);
+	}
+	return output;
+}
+
+// File names as found in photo folders: camera names, copies, screenshots,
+// etc. with numbers of various lengths, some of them zero-padded, in random
+// order.
+QStringList syntheticFileNames(int count) {
+	QStringList output;
+	output.reserve(count);
+	quint32 seed = 12345;
+	for (int i = 0; i < count; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		int n = (int)(seed >> 8) % (count * 2);
+		switch ((seed >> 4) % 5) {
+			case 0: output.append(QString("IMG_%1.JPG").arg(n, 5, 10, QChar('0'))); break;
+			case 1: output.append(QString("DSC%1.jpg").arg(n % 10000, 4, 10, QChar('0'))); break;
+			case 2: output.append(QString("photo (%1).png").arg(n)); break;
+			case 3: output.append(QString("Screenshot 2015-%1-%2 at %3.png").arg(n % 12 + 1).arg(n % 28 + 1).arg(n)); break;
+			default: output.append(QString("holiday%1_v%2.jpeg").arg(n / 100).arg(n % 100)); break;
+		}
+	}
+	return output;
+}
+
+// Hashes of bursts of similar images: random hashes with a few bits
+// changed in each copy
+std::vector<ImageHash> burstHashes(int count) {
+	std::vector<ImageHash> output(count);
+	quint32 seed = 12345;
+	quint64 dHash = 0;
+	quint64 pHash = 0;
+	for (int i = 0; i < count; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		// New burst every 8 images on average
+		if (i == 0 || (seed >> 8) % 8 == 0) {
+			dHash = ((quint64)seed << 32) ^ (seed * 2654435761u);
+			pHash = ((quint64)(seed * 2246822519u) << 32) ^ (seed * 3266489917u);
+		}
+		output[i].valid = true;
+		output[i].dHash = dHash ^ (Q_UINT64_C(1) << ((seed >> 12) % 64));
+		output[i].pHash = pHash ^ (Q_UINT64_C(1) << ((seed >> 18) % 64));
+	}
+	return output;
+}
+
+// Stands in for the imaging calls of a batch script: decodes a photo, halves
+// it and encodes it again. The output is discarded so that the input file
+// can be used for every run.
+QScriptValue resizeImage(QScriptContext* context, QScriptEngine*) {
+	QImage image(context->argument(0).toString());
+	QImage scaled = image.scaled(image.size() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	QByteArray data;
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+	scaled.save(&buffer, "jpg", 90);
+	return QScriptValue(data.size());
+}
+
+// Works like BatchWorkerThread, which can't be used without the running
+// application: runs a script once per file on its own engine, taking the
+// files from a shared queue.
+class ScriptWorkerThread : public QThread {
+
+public:
+
+	ScriptWorkerThread(const QStringList* filePaths, int* nextFileIndex, QMutex* mutex) {
+		filePaths_ = filePaths;
+		nextFileIndex_ = nextFileIndex;
+		mutex_ = mutex;
+		errorCount_ = 0;
+	}
+
+	void run() {
+		QScriptEngine engine;
+		engine.globalObject().setProperty("resizeImage", engine.newFunction(resizeImage));
+
+		QString filePath;
+		while (takeFile(&filePath)) {
+			engine.globalObject().setProperty("filePath", filePath);
+			engine.evaluate("if (resizeImage(filePath) <= 0) throw 'Could not resize ' + filePath;");
+			if (engine.hasUncaughtException()) errorCount_++;
+		}
+	}
+
+	int errorCount() const {
+		return errorCount_;
+	}
+
+private:
+
+	bool takeFile(QString* filePath) {
+		QMutexLocker locker(mutex_);
+		if (*nextFileIndex_ >= filePaths_->size()) return false;
+		*filePath = filePaths_->at(*nextFileIndex_);
+		(*nextFileIndex_)++;
+		return true;
+	}
+
+	const QStringList* filePaths_;
+	int* nextFileIndex_;
+	QMutex* mutex_;
+	int errorCount_;
+
+};
+
+// The comparator that naturalSort() replaces, as it was before sort keys:
+// it extracts the numbers at the first difference into QStrings at every
+// comparison. Kept as the baseline for the naturalSort benchmark.
+struct LegacyNaturalSortCompare {
+
+	static bool isNumber(QChar c) {
+		return c >= '0' && c <= '9';
+	}
+
+	bool operator() (const QString& s1, const QString& s2) const {
+		if (s1 == "" || s2 == "") return s1 < s2;
+
+		// Move to the first difference between the strings
+		int startIndex = -1;
+		int length = s1.length() > s2.length() ? s2.length() : s1.length();
+		for (int i = 0; i < length; i++) {
+			QChar c1 = s1[i];
+			QChar c2 = s2[i];
+			if (c1 != c2) {
+				startIndex = i;
+				break;
+			}
+		}
+
+		// If the strings are the same, exit now.
+		if (startIndex < 0) return s1 < s2;
+
+		// Now extract the numbers, if any, from the two strings.
+		QString sn1;
+		QString sn2;
+		bool done1 = false;
+		bool done2 = false;
+		length = s1.length() < s2.length() ? s2.length() : s1.length();
+
+		for (int i = startIndex; i < length; i++) {
+			if (!done1 && i < s1.length()) {
+				if (isNumber(s1[i])) {
+					sn1 += QString(s1[i]);
+				} else {
+					done1 = true;
+				}
+			}
+
+			if (!done2 && i < s2.length()) {
+				if (isNumber(s2[i])) {
+					sn2 += QString(s2[i]);
+				} else {
+					done2 = true;
+				}
+			}
+
+			if (done1 && done2) break;
+		}
+
+		// If none of the string contain a number, use a regular comparison.
+		if (sn1 == "" && sn2 == "") return s1 < s2;
+
+		// If one of the strings doesn't contain a number at that position,
+		// we put the string without number first so that, for example,
+		// "example.bin" is before "example1.bin"
+		if (sn1 == "" && sn2 != "") return true;
+		if (sn1 != "" && sn2 == "") return false;
+
+		return sn1.toInt() < sn2.toInt();
+	}
+
+};
+
+}
+
+// Run with eg. "-iterations 5" for stable numbers, and with a row name to
+// only run that case, eg. "scaleImage:box 8000x6000 AVX2".
+class Benchmarks : public QObject {
+
+	Q_OBJECT
+
+private:
+
+	QImage largeImage_;
+
+private slots:
+
+	void cleanup() {
+		resampler::setInstructionSet(resampler::supportedInstructionSet());
+	}
+
+	// Full resolution photo to the size of a screen (box), and a 2x
+	// reduction (Lanczos3), for each instruction set. "Qt" is
+	// Qt::SmoothTransformation, which the resampler replaces.
+	void scaleImage_data() {
+		QTest::addColumn<QString>("implementation");
+		QTest::addColumn<resampler::InstructionSet>("instructionSet");
+		QTest::addColumn<resampler::Filter>("filter");
+		QTest::addColumn<QSize>("outputSize");
+
+		const char* instructionSetNames[] = { "Generic", "SSE4.1", "AVX2" };
+		resampler::InstructionSet instructionSets[] = { resampler::Generic, resampler::Sse41, resampler::Avx2 };
+
+		QTest::newRow("box 8000x6000 Qt") << "qt" << resampler::Generic << resampler::Box << QSize(1920, 1440);
+		for (int i = 0; i < 3; i++) {
+			QTest::newRow(qPrintable(QString("box 8000x6000 %1").arg(instructionSetNames[i]))) << "resampler" << instructionSets[i] << resampler::Box << QSize(1920, 1440);
+		}
+
+		QTest::newRow("lanczos3 8000x6000 Qt") << "qt" << resampler::Generic << resampler::Lanczos3 << QSize(4000, 3000);
+		for (int i = 0; i < 3; i++) {
+			QTest::newRow(qPrintable(QString("lanczos3 8000x6000 %1").arg(instructionSetNames[i]))) << "resampler" << instructionSets[i] << resampler::Lanczos3 << QSize(4000, 3000);
+		}
+	}
+
+	void scaleImage() {
+		QFETCH(QString, implementation);
+		QFETCH(resampler::InstructionSet, instructionSet);
+		QFETCH(resampler::Filter, filter);
+		QFETCH(QSize, outputSize);
+
+		// Only created when needed since it takes about 200MB
+		if (largeImage_.isNull()) largeImage_ = noiseImage(QSize(8000, 6000));
+
+		if (implementation == "qt") {
+			QImage output;
+			QBENCHMARK {
+				output = largeImage_.scaled(outputSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+			}
+			QCOMPARE(output.size(), outputSize);
+			return;
+		}
+
+		if (instructionSet > resampler::supportedInstructionSet()) QSKIP("Instruction set not supported by this CPU or build");
+		resampler::setInstructionSet(instructionSet);
+
+		QImage output;
+		QBENCHMARK {
+			output = resampler::scaled(largeImage_, outputSize, Qt::IgnoreAspectRatio, filter);
+		}
+		QCOMPARE(output.size(), outputSize);
+	}
+
+	// naturalSort() computes the key of each name once. "legacy" is how
+	// lists used to be sorted (std::sort with the QString extracting
+	// comparator), and is the baseline. "compare" is std::sort with
+	// NaturalSortCompare, which computes both keys at every comparison.
+	void naturalSort_data() {
+		QTest::addColumn<QString>("implementation");
+		QTest::addColumn<int>("count");
+
+		QTest::newRow("keys 100k") << "keys" << 100000;
+		QTest::newRow("keys 1M") << "keys" << 1000000;
+		QTest::newRow("legacy 100k") << "legacy" << 100000;
+		QTest::newRow("legacy 1M") << "legacy" << 1000000;
+		QTest::newRow("compare 100k") << "compare" << 100000;
+		QTest::newRow("compare 1M") << "compare" << 1000000;
+	}
+
+	void naturalSort() {
+		QFETCH(QString, implementation);
+		QFETCH(int, count);
+
+		QStringList fileNames = syntheticFileNames(count);
+		QStringList sorted;
+
+		if (implementation == "keys") {
+			QBENCHMARK {
+				sorted = fileNames;
+				stringutil::naturalSort(sorted);
+			}
+		} else if (implementation == "legacy") {
+			QBENCHMARK {
+				sorted = fileNames;
+				std::sort(sorted.begin(), sorted.end(), LegacyNaturalSortCompare());
+			}
+		} else {
+			QBENCHMARK {
+				sorted = fileNames;
+				std::sort(sorted.begin(), sorted.end(), stringutil::NaturalSortCompare());
+			}
+		}
+
+		QCOMPARE(sorted.size(), count);
+	}
+
+	// Computing the keys alone, which is what inserting a file or building
+	// the sort keys of a batch of files costs
+	void naturalSortKey_data() {
+		QTest::addColumn<int>("count");
+
+		QTest::newRow("100k") << 100000;
+		QTest::newRow("1M") << 1000000;
+	}
+
+	void naturalSortKey() {
+		QFETCH(int, count);
+
+		QStringList fileNames = syntheticFileNames(count);
+		qint64 totalSize = 0;
+
+		QBENCHMARK {
+			totalSize = 0;
+			for (int i = 0; i < fileNames.size(); i++) totalSize += stringutil::naturalSortKey(fileNames[i]).size();
+		}
+
+		QVERIFY(totalSize > 0);
+	}
+
+	// Hashing a 12 megapixel JPEG photo, including the scaled-down decode,
+	// compared with hashing the already decoded image, which is mostly the
+	// DCT. It shows how much of the time the DCT takes.
+	void imageHash_data() {
+		QTest::addColumn<bool>("decode");
+
+		QTest::newRow("decode and hash") << true;
+		QTest::newRow("hash only") << false;
+	}
+
+	void imageHash() {
+		QFETCH(bool, decode);
+
+		QTemporaryDir dir;
+		QString filePath = dir.path() + "/photo.jpg";
+		QVERIFY(photoImage(QSize(4000, 3000)).save(filePath, "jpg", 90));
+
+		QImageReader reader(filePath);
+		reader.setScaledSize(QSize(64, 64));
+		QImage scaled = reader.read();
+
+		ImageHash hash;
+		if (decode) {
+			QBENCHMARK {
+				hash = DuplicateFinder::computeHash(filePath);
+			}
+		} else {
+			QBENCHMARK {
+				hash = DuplicateFinder::computeHash(scaled);
+			}
+		}
+		QVERIFY(hash.valid);
+	}
+
+	// A batch action run by BatchScheduler's model of one script engine per
+	// thread, on a single engine (as batches used to run) and on one engine
+	// per core. The ratio of the two is the speedup of parallel batches on
+	// this machine.
+	void batchEngines_data() {
+		QTest::addColumn<int>("engineCount");
+
+		QTest::newRow("one engine") << 1;
+		QTest::newRow("one engine per core") << QThread::idealThreadCount();
+	}
+
+	void batchEngines() {
+		QFETCH(int, engineCount);
+
+		QTemporaryDir dir;
+		QString filePath = dir.path() + "/photo.jpg";
+		QVERIFY(photoImage(QSize(3000, 2000)).save(filePath, "jpg", 90));
+
+		QStringList filePaths;
+		for (int i = 0; i < 64; i++) filePaths.append(filePath);
+
+		int errorCount = 0;
+		QBENCHMARK {
+			int nextFileIndex = 0;
+			QMutex mutex;
+			std::vector<ScriptWorkerThread*> threads;
+			for (int i = 0; i < engineCount; i++) {
+				threads.push_back(new ScriptWorkerThread(&filePaths, &nextFileIndex, &mutex));
+				threads.back()->start();
+			}
+
+			errorCount = 0;
+			for (int i = 0; i < (int)threads.size(); i++) {
+				threads[i]->wait();
+				errorCount += threads[i]->errorCount();
+				delete threads[i];
+			}
+		}
+
+		QCOMPARE(errorCount, 0);
+	}
+
+	// Grouping directories of burst shots, at the default threshold
+	void duplicateGroup_data() {
+		QTest::addColumn<int>("count");
+
+		QTest::newRow("10k") << 10000;
+		QTest::newRow("100k") << 100000;
+	}
+
+	void duplicateGroup() {
+		QFETCH(int, count);
+
+		QStringList fileNames = syntheticFileNames(count);
+		std::vector<ImageHash> hashes = burstHashes(count);
+		DuplicateGroups groups;
+
+		QBENCHMARK {
+			groups = DuplicateFinder::group(fileNames, hashes, 10);
+		}
+
+		QVERIFY(groups.size() > 0);
+	}
+
+};
+
+QTEST_APPLESS_MAIN(Benchmarks)
+
+#include "benchmarks.moc"
@@ -0,0 +1,27 @@
+include(../tests.pri)
+
+TARGET = tst_duplicatefinder
+
+CONFIG += testcase
+
+HEADERS += \
+	$$SRC_DIR/duplicatefinder.h \
+	$$SRC_DIR/exif.h \
+	$$SRC_DIR/metadataindex.h \
+	$$SRC_DIR/ziparchive.h
+
+SOURCES += \
+	tst_duplicatefinder.cpp \
+	$$SRC_DIR/duplicatefinder.cpp \
+	$$SRC_DIR/exif.cpp \
+	$$SRC_DIR/metadataindex.cpp \
+	$$SRC_DIR/ziparchive.cpp
+
+macx {
+	LIBS += /usr/local/Cellar/freeimage/3.15.4/lib/libfreeimage.dylib
+}
+
+unix {
+	LIBS += /usr/lib/libfreeimage.so
+	LIBS += -lz
+}
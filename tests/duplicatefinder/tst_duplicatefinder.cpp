@@ -0,0 +1,166 @@
+#include <QtTest>
+
+#include "duplicatefinder.h"
+
+using namespace mv;
+
+namespace {
+
+quint32 nextRandom(quint32* seed) {
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed >> 8;
+}
+
+quint64 randomHash(quint32* seed) {
+	return ((quint64)nextRandom(seed) << 40) ^ ((quint64)nextRandom(seed) << 20) ^ nextRandom(seed);
+}
+
+quint64 flipBits(quint64 hash, int count, quint32* seed) {
+	for (int i = 0; i < count; i++) hash ^= Q_UINT64_C(1) << (nextRandom(seed) % 64);
+	return hash;
+}
+
+// Bursts of similar hashes around a few random centers, in random order,
+// with some files that couldn't be decoded
+std::vector<ImageHash> burstHashes(int count, int centerCount, int maxFlips, quint32 seed) {
+	std::vector<quint64> dCenters;
+	std::vector<quint64> pCenters;
+	for (int i = 0; i < centerCount; i++) {
+		dCenters.push_back(randomHash(&seed));
+		pCenters.push_back(randomHash(&seed));
+	}
+
+	std::vector<ImageHash> output(count);
+	for (int i = 0; i < count; i++) {
+		if (nextRandom(&seed) % 20 == 0) continue;
+		int center = nextRandom(&seed) % centerCount;
+		output[i].valid = true;
+		output[i].dHash = flipBits(dCenters[center], nextRandom(&seed) % (maxFlips + 1), &seed);
+		output[i].pHash = flipBits(pCenters[center], nextRandom(&seed) % (maxFlips + 1), &seed);
+	}
+	return output;
+}
+
+// Compares every pair of files, then lists the connected sets in the same
+// order as DuplicateFinder::group().
+DuplicateGroups bruteForceGroup(const QStringList& fileNames, const std::vector<ImageHash>& hashes, int threshold) {
+	int count = fileNames.size();
+	std::vector<std::vector<int> > neighbours(count);
+	for (int i = 0; i < count; i++) {
+		if (!hashes[i].valid) continue;
+		for (int j = 0; j < i; j++) {
+			if (!hashes[j].valid) continue;
+			if (DuplicateFinder::distance(hashes[i].pHash, hashes[j].pHash) > threshold) continue;
+			if (DuplicateFinder::distance(hashes[i].dHash, hashes[j].dHash) > threshold) continue;
+			neighbours[i].push_back(j);
+			neighbours[j].push_back(i);
+		}
+	}
+
+	DuplicateGroups output;
+	std::vector<bool> visited(count, false);
+	for (int i = 0; i < count; i++) {
+		if (visited[i]) continue;
+
+		std::vector<int> members;
+		std::vector<int> stack(1, i);
+		visited[i] = true;
+		while (!stack.empty()) {
+			int index = stack.back();
+			stack.pop_back();
+			members.push_back(index);
+			for (int j = 0; j < (int)neighbours[index].size(); j++) {
+				if (visited[neighbours[index][j]]) continue;
+				visited[neighbours[index][j]] = true;
+				stack.push_back(neighbours[index][j]);
+			}
+		}
+
+		if (members.size() < 2) continue;
+		std::sort(members.begin(), members.end());
+		QStringList group;
+		for (int j = 0; j < (int)members.size(); j++) group.append(fileNames[members[j]]);
+		output.append(group);
+	}
+	return output;
+}
+
+// Shapes over a gradient, so that the image has structure at several scales
+QImage testImage(const QSize& size) {
+	QImage output(size, QImage::Format_RGB32);
+	for (int y = 0; y < size.height(); y++) {
+		QRgb* row = (QRgb*)output.scanLine(y);
+		for (int x = 0; x < size.width(); x++) {
+			int v = x * 200 / size.width() + y * 55 / size.height();
+			row[x] = qRgb(v, v, v);
+		}
+	}
+
+	QPainter painter(&output);
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(Qt::white);
+	painter.drawEllipse(QRectF(size.width() * 0.1, size.height() * 0.2, size.width() * 0.3, size.height() * 0.4));
+	painter.setBrush(Qt::black);
+	painter.drawRect(QRectF(size.width() * 0.6, size.height() * 0.5, size.width() * 0.25, size.height() * 0.35));
+	return output;
+}
+
+}
+
+class TestDuplicateFinder : public QObject {
+
+	Q_OBJECT
+
+private slots:
+
+	// Checked against comparing every pair. The high threshold is above the
+	// one at which group() does that itself rather than using its index.
+	void group_data() {
+		QTest::addColumn<int>("count");
+		QTest::addColumn<int>("centerCount");
+		QTest::addColumn<int>("maxFlips");
+		QTest::addColumn<int>("threshold");
+
+		QTest::newRow("exact duplicates") << 500 << 100 << 0 << 0;
+		QTest::newRow("tight bursts") << 1000 << 50 << 4 << 6;
+		QTest::newRow("bursts near threshold") << 1000 << 50 << 10 << 10;
+		QTest::newRow("loose bursts") << 3000 << 300 << 16 << 12;
+		QTest::newRow("many small groups") << 1000 << 1000 << 0 << 4;
+		QTest::newRow("high threshold") << 300 << 10 << 20 << 30;
+	}
+
+	void group() {
+		QFETCH(int, count);
+		QFETCH(int, centerCount);
+		QFETCH(int, maxFlips);
+		QFETCH(int, threshold);
+
+		QStringList fileNames;
+		for (int i = 0; i < count; i++) fileNames.append(QString("IMG_%1.jpg").arg(i));
+		std::vector<ImageHash> hashes = burstHashes(count, centerCount, maxFlips, count + centerCount + maxFlips);
+
+		QCOMPARE(DuplicateFinder::group(fileNames, hashes, threshold), bruteForceGroup(fileNames, hashes, threshold));
+	}
+
+	void computeHash() {
+		QImage image = testImage(QSize(640, 480));
+		ImageHash hash = DuplicateFinder::computeHash(image);
+		QVERIFY(hash.valid);
+
+		// Resized copies look the same, mirrored ones don't
+		ImageHash resizedHash = DuplicateFinder::computeHash(image.scaled(QSize(200, 150), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+		QVERIFY(resizedHash.valid);
+		QVERIFY(DuplicateFinder::distance(hash.dHash, resizedHash.dHash) <= 4);
+		QVERIFY(DuplicateFinder::distance(hash.pHash, resizedHash.pHash) <= 4);
+
+		ImageHash mirroredHash = DuplicateFinder::computeHash(image.mirrored(true, false));
+		QVERIFY(DuplicateFinder::distance(hash.dHash, mirroredHash.dHash) > 16);
+
+		QVERIFY(!DuplicateFinder::computeHash(QImage()).valid);
+	}
+
+};
+
+QTEST_APPLESS_MAIN(TestDuplicateFinder)
+
+#include "tst_duplicatefinder.moc"
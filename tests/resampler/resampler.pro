@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_resampler
+
+CONFIG += testcase
+
+HEADERS += \
+	$$SRC_DIR/resampler.h
+
+SOURCES += \
+	tst_resampler.cpp \
+	$$SRC_DIR/resampler.cpp
@@ -0,0 +1,238 @@
+#include <QtTest>
+
+#include "resampler.h"
+
+using namespace mv;
+
+Q_DECLARE_METATYPE(mv::resampler::Filter)
+Q_DECLARE_METATYPE(mv::resampler::InstructionSet)
+
+namespace {
+
+struct Tap {
+	int index;
+	double weight;
+};
+
+typedef std::vector<std::vector<Tap> > Taps;
+
+const double Pi = 3.14159265358979323846;
+
+double sinc(double x) {
+	if (x == 0.0) return 1.0;
+	x *= Pi;
+	return sin(x) / x;
+}
+
+double lanczos3(double x) {
+	if (x <= -3.0 || x >= 3.0) return 0.0;
+	return sinc(x) * sinc(x / 3.0);
+}
+
+// Weights of the source pixels for each output pixel along one axis, as
+// defined by the filter rather than by the resampler's implementation: all
+// the source pixels within the filter support, normalized, in double
+// precision.
+Taps referenceTaps(int sourceSize, int outputSize, resampler::Filter filter) {
+	Taps output(outputSize);
+	double scale = (double)sourceSize / (double)outputSize;
+	double filterScale = qMax(scale, 1.0);
+
+	for (int i = 0; i < outputSize; i++) {
+		double center = ((double)i + 0.5) * scale;
+		std::vector<Tap>& taps = output[i];
+
+		if (filter == resampler::Box && scale <= 1.0) {
+			Tap tap = { qBound(0, (int)floor(center), sourceSize - 1), 1.0 };
+			taps.push_back(tap);
+			continue;
+		}
+
+		double total = 0.0;
+		for (int j = 0; j < sourceSize; j++) {
+			double w;
+			if (filter == resampler::Box) {
+				w = qMin(center + scale / 2.0, (double)(j + 1)) - qMax(center - scale / 2.0, (double)j);
+				if (w <= 0.0) continue;
+			} else {
+				w = lanczos3(((double)j + 0.5 - center) / filterScale);
+				if (w == 0.0) continue;
+			}
+			Tap tap = { j, w };
+			taps.push_back(tap);
+			total += w;
+		}
+
+		for (int k = 0; k < (int)taps.size(); k++) taps[k].weight /= total;
+	}
+
+	return output;
+}
+
+// Direct 2D convolution, in the same pixel format as the resampler output
+QImage referenceScaled(const QImage& source, const QSize& size, resampler::Filter filter) {
+	Taps horizontal = referenceTaps(source.width(), size.width(), filter);
+	Taps vertical = referenceTaps(source.height(), size.height(), filter);
+	bool premultiplied = source.format() == QImage::Format_ARGB32_Premultiplied;
+
+	QImage output(size, source.format());
+
+	for (int y = 0; y < size.height(); y++) {
+		QRgb* outputRow = (QRgb*)output.scanLine(y);
+
+		for (int x = 0; x < size.width(); x++) {
+			double sums[4] = { 0, 0, 0, 0 };
+
+			for (int ky = 0; ky < (int)vertical[y].size(); ky++) {
+				const QRgb* sourceRow = (const QRgb*)source.constScanLine(vertical[y][ky].index);
+				for (int kx = 0; kx < (int)horizontal[x].size(); kx++) {
+					double w = vertical[y][ky].weight * horizontal[x][kx].weight;
+					QRgb p = sourceRow[horizontal[x][kx].index];
+					sums[0] += w * qRed(p);
+					sums[1] += w * qGreen(p);
+					sums[2] += w * qBlue(p);
+					sums[3] += w * qAlpha(p);
+				}
+			}
+
+			int c[4];
+			for (int i = 0; i < 4; i++) c[i] = qBound(0, (int)floor(sums[i] + 0.5), 255);
+			if (premultiplied) {
+				for (int i = 0; i < 3; i++) c[i] = qMin(c[i], c[3]);
+			}
+			outputRow[x] = qRgba(c[0], c[1], c[2], premultiplied ? c[3] : 255);
+		}
+	}
+
+	return output;
+}
+
+// Noise over smooth gradients, so that both the high frequencies (where
+// Lanczos overshoots) and the plain areas are covered. The generator is
+// seeded so that failures can be reproduced.
+QImage testImage(const QSize& size, bool alpha) {
+	QImage output(size, alpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+	quint32 seed = 12345;
+
+	for (int y = 0; y < size.height(); y++) {
+		QRgb* row = (QRgb*)output.scanLine(y);
+		for (int x = 0; x < size.width(); x++) {
+			seed = seed * 1664525u + 1013904223u;
+			int noise = (int)(seed >> 24);
+			int a = alpha ? (x * 255) / qMax(1, size.width() - 1) : 255;
+			int r = (x + y) % 2 ? noise : (x * 255) / qMax(1, size.width() - 1);
+			int g = (y * 255) / qMax(1, size.height() - 1);
+			int b = (noise + x * 7) % 256;
+			row[x] = qRgba(r * a / 255, g * a / 255, b * a / 255, a);
+		}
+	}
+
+	return output;
+}
+
+QString instructionSetName(resampler::InstructionSet v) {
+	if (v == resampler::Avx2) return "AVX2";
+	if (v == resampler::Sse41) return "SSE4.1";
+	return "Generic";
+}
+
+}
+
+class TestResampler : public QObject {
+
+	Q_OBJECT
+
+private slots:
+
+	void cleanup() {
+		resampler::setInstructionSet(resampler::supportedInstructionSet());
+	}
+
+	void matchesReference_data() {
+		QTest::addColumn<resampler::InstructionSet>("instructionSet");
+		QTest::addColumn<resampler::Filter>("filter");
+		QTest::addColumn<QSize>("sourceSize");
+		QTest::addColumn<QSize>("outputSize");
+		QTest::addColumn<bool>("alpha");
+
+		resampler::InstructionSet instructionSets[] = { resampler::Generic, resampler::Sse41, resampler::Avx2 };
+
+		for (int i = 0; i < 3; i++) {
+			resampler::InstructionSet s = instructionSets[i];
+			QString n = instructionSetName(s);
+
+			// Odd widths so that the SIMD loops also go through their tails
+			QTest::newRow(qPrintable(n + " box 4x down")) << s << resampler::Box << QSize(403, 301) << QSize(100, 75) << false;
+			QTest::newRow(qPrintable(n + " box 2.7x down")) << s << resampler::Box << QSize(271, 163) << QSize(100, 60) << false;
+			QTest::newRow(qPrintable(n + " box up")) << s << resampler::Box << QSize(37, 29) << QSize(101, 67) << false;
+			QTest::newRow(qPrintable(n + " lanczos3 2x down")) << s << resampler::Lanczos3 << QSize(322, 242) << QSize(161, 121) << false;
+			QTest::newRow(qPrintable(n + " lanczos3 1.3x down")) << s << resampler::Lanczos3 << QSize(333, 222) << QSize(257, 171) << false;
+			QTest::newRow(qPrintable(n + " lanczos3 up")) << s << resampler::Lanczos3 << QSize(41, 31) << QSize(97, 71) << false;
+			QTest::newRow(qPrintable(n + " lanczos3 alpha")) << s << resampler::Lanczos3 << QSize(205, 157) << QSize(99, 81) << true;
+			QTest::newRow(qPrintable(n + " box alpha")) << s << resampler::Box << QSize(405, 317) << QSize(97, 73) << true;
+			// Enough rows for the image to be split into several bands
+			QTest::newRow(qPrintable(n + " lanczos3 tall")) << s << resampler::Lanczos3 << QSize(67, 1203) << QSize(31, 517) << false;
+		}
+	}
+
+	// Every channel of every pixel must be within one level of the
+	// reference, which only allows for the float rounding of the resampler.
+	void matchesReference() {
+		QFETCH(resampler::InstructionSet, instructionSet);
+		QFETCH(resampler::Filter, filter);
+		QFETCH(QSize, sourceSize);
+		QFETCH(QSize, outputSize);
+		QFETCH(bool, alpha);
+
+		if (instructionSet > resampler::supportedInstructionSet()) QSKIP("Instruction set not supported by this CPU or build");
+		resampler::setInstructionSet(instructionSet);
+		QCOMPARE(resampler::instructionSet(), instructionSetName(instructionSet));
+
+		QImage source = testImage(sourceSize, alpha);
+		QImage output = resampler::scaled(source, outputSize, Qt::IgnoreAspectRatio, filter);
+		QImage expected = referenceScaled(source, outputSize, filter);
+
+		QCOMPARE(output.size(), outputSize);
+		QCOMPARE(output.format(), expected.format());
+
+		int maxDifference = 0;
+		QPoint maxDifferencePos;
+		for (int y = 0; y < outputSize.height(); y++) {
+			const QRgb* outputRow = (const QRgb*)output.constScanLine(y);
+			const QRgb* expectedRow = (const QRgb*)expected.constScanLine(y);
+			for (int x = 0; x < outputSize.width(); x++) {
+				QRgb p1 = outputRow[x];
+				QRgb p2 = expectedRow[x];
+				int d = qMax(qMax(qAbs(qRed(p1) - qRed(p2)), qAbs(qGreen(p1) - qGreen(p2))), qAbs(qBlue(p1) - qBlue(p2)));
+				if (alpha) d = qMax(d, qAbs(qAlpha(p1) - qAlpha(p2)));
+				if (d > maxDifference) {
+					maxDifference = d;
+					maxDifferencePos = QPoint(x, y);
+				}
+			}
+		}
+
+		if (maxDifference > 1) qWarning() << "Largest difference at" << maxDifferencePos;
+		QVERIFY2(maxDifference <= 1, qPrintable(QString("Difference of %1 levels").arg(maxDifference)));
+	}
+
+	void keepsAspectRatio() {
+		QImage output = resampler::scaled(testImage(QSize(400, 100), false), QSize(200, 200), Qt::KeepAspectRatio);
+		QCOMPARE(output.size(), QSize(200, 50));
+	}
+
+	void sameSizeReturnsSource() {
+		QImage source = testImage(QSize(64, 48), false);
+		QCOMPARE(resampler::scaled(source, source.size()).cacheKey(), source.cacheKey());
+	}
+
+	void nullImage() {
+		QVERIFY(resampler::scaled(QImage(), QSize(10, 10)).isNull());
+		QVERIFY(resampler::scaled(testImage(QSize(10, 10), false), QSize(0, 10)).isNull());
+	}
+
+};
+
+QTEST_APPLESS_MAIN(TestResampler)
+
+#include "tst_resampler.moc"
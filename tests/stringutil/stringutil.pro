@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_stringutil
+
+CONFIG += testcase
+
+HEADERS += \
+	$$SRC_DIR/stringutil.h
+
+SOURCES += \
+	tst_stringutil.cpp \
+	$$SRC_DIR/stringutil.cpp
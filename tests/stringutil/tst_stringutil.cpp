@@ -0,0 +1,67 @@
+#include <QtTest>
+
+#include "stringutil.h"
+
+using namespace mv;
+
+class TestStringUtil : public QObject {
+
+	Q_OBJECT
+
+private slots:
+
+	// Each list is in natural order, and every pair of names in it is
+	// checked, not only the adjacent ones.
+	void naturalSortKey_data() {
+		QTest::addColumn<QStringList>("names");
+
+		QTest::newRow("numbers by value") << (QStringList() << "file2" << "file10" << "file100");
+		QTest::newRow("several numbers") << (QStringList() << "holiday9_v2.jpeg" << "holiday9_v10.jpeg" << "holiday10_v1.jpeg");
+		QTest::newRow("zero-padded numbers") << (QStringList() << "IMG_2.jpg" << "IMG_10.jpg" << "IMG_0100.jpg" << "IMG_101.jpg");
+
+		// Leading zeros only decide between names that are otherwise equal
+		QTest::newRow("leading zeros") << (QStringList() << "0" << "00" << "1" << "01" << "001" << "2");
+		QTest::newRow("leading zeros before text") << (QStringList() << "img1" << "img01" << "img2");
+		QTest::newRow("leading zeros after text") << (QStringList() << "01a" << "1b");
+		QTest::newRow("leading zeros in order") << (QStringList() << "a1b02" << "a01b2");
+
+		QTest::newRow("mixed text and numbers") << (QStringList() << "a2b" << "a2b1" << "a10");
+		QTest::newRow("number then text") << (QStringList() << "x9y" << "x10a");
+		QTest::newRow("number after text") << (QStringList() << "example.bin" << "example1.bin");
+
+		// The shorter of two names that start the same is first
+		QTest::newRow("text prefixes") << (QStringList() << "abc" << "abcd" << "abd");
+		QTest::newRow("number prefixes") << (QStringList() << "photo" << "photo 1" << "photo1" << "photo1a" << "photo2");
+		QTest::newRow("empty") << (QStringList() << "" << "a" << "0");
+	}
+
+	void naturalSortKey() {
+		QFETCH(QStringList, names);
+
+		for (int i = 0; i < names.size(); i++) {
+			QCOMPARE(stringutil::naturalSortKey(names[i]), stringutil::naturalSortKey(names[i]));
+			for (int j = i + 1; j < names.size(); j++) {
+				bool ordered = stringutil::naturalSortKey(names[i]) < stringutil::naturalSortKey(names[j]);
+				QVERIFY2(ordered, qPrintable(QString("\"%1\" is not before \"%2\"").arg(names[i]).arg(names[j])));
+				QVERIFY(stringutil::NaturalSortCompare()(names[i], names[j]));
+				QVERIFY(!stringutil::NaturalSortCompare()(names[j], names[i]));
+			}
+		}
+	}
+
+	void naturalSort() {
+		QStringList expected;
+		expected << "" << "IMG_b.jpg" << "IMG_1.jpg" << "IMG_01.jpg" << "IMG_2.jpg" << "IMG_10.jpg" << "IMG_10a.jpg" << "IMG_100.jpg";
+
+		QStringList names;
+		names << "IMG_10a.jpg" << "IMG_2.jpg" << "IMG_100.jpg" << "" << "IMG_01.jpg" << "IMG_b.jpg" << "IMG_10.jpg" << "IMG_1.jpg";
+		stringutil::naturalSort(names);
+
+		QCOMPARE(names, expected);
+	}
+
+};
+
+QTEST_APPLESS_MAIN(TestStringUtil)
+
+#include "tst_stringutil.moc"
@@ -0,0 +1,17 @@
+# Settings shared by the test and benchmark projects. They build the source
+# files they need directly from src/, with the same precompiled header as
+# the application.
+
+QT += widgets script testlib
+
+CONFIG += precompile_header console
+CONFIG -= app_bundle
+
+SRC_DIR = $$PWD/../src
+
+INCLUDEPATH += $$SRC_DIR
+PRECOMPILED_HEADER = $$SRC_DIR/stable.h
+
+macx {
+	INCLUDEPATH += "/usr/local/Cellar/freeimage/3.15.4/include"
+}
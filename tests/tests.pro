@@ -0,0 +1,12 @@
+# Tests and benchmarks of the parts of the application that don't need a
+# GUI. Build with qmake in this folder, then run "make check" for the tests.
+# The benchmarks are run directly, eg. "benchmarks/benchmarks -iterations 5"
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+	duplicatefinder \
+	resampler \
+	stringutil \
+	tiffreader \
+	benchmarks
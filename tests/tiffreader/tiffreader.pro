@@ -0,0 +1,19 @@
+include(../tests.pri)
+
+TARGET = tst_tiffreader
+
+CONFIG += testcase
+
+HEADERS += \
+	$$SRC_DIR/tiffreader.h
+
+SOURCES += \
+	tst_tiffreader.cpp \
+	$$SRC_DIR/tiffreader.cpp
+
+macx {
+	INCLUDEPATH += /usr/local/include
+	LIBS += -L/usr/local/lib
+}
+
+LIBS += -ltiff
@@ -0,0 +1,162 @@
+#include <QtTest>
+
+#include <tiffio.h>
+
+#include "tiffreader.h"
+
+using namespace mv;
+
+namespace {
+
+const int Width = 1000;
+const int Height = 700;
+
+// Different in each channel and not periodic over a tile or block, so that
+// misplaced rows, columns or tiles show up.
+int pixelValue(int x, int y, int channel) {
+	return (x * 7 + y * 13 + channel * 101 + (x * y) % 17) % 256;
+}
+
+// RGB image with the given tile size, or with strips of `chunkSize` rows.
+// The size is not a multiple of the chunk size, so that there are partial
+// tiles and strips.
+bool writeTiff(const QString& filePath, bool tiled, int chunkSize) {
+	TIFF* tiff = TIFFOpen(QFile::encodeName(filePath).constData(), "w");
+	if (!tiff) return false;
+
+	TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, (quint32)Width);
+	TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, (quint32)Height);
+	TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 3);
+	TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+
+	bool ok = true;
+
+	if (tiled) {
+		TIFFSetField(tiff, TIFFTAG_TILEWIDTH, (quint32)chunkSize);
+		TIFFSetField(tiff, TIFFTAG_TILELENGTH, (quint32)chunkSize);
+		QByteArray tile(chunkSize * chunkSize * 3, 0);
+		for (int tileY = 0; tileY < Height; tileY += chunkSize) {
+			for (int tileX = 0; tileX < Width; tileX += chunkSize) {
+				for (int y = 0; y < chunkSize; y++) {
+					for (int x = 0; x < chunkSize; x++) {
+						for (int c = 0; c < 3; c++) {
+							bool inside = tileX + x < Width && tileY + y < Height;
+							tile[(y * chunkSize + x) * 3 + c] = inside ? (char)pixelValue(tileX + x, tileY + y, c) : 0;
+						}
+					}
+				}
+				ok = ok && TIFFWriteTile(tiff, tile.data(), tileX, tileY, 0, 0) >= 0;
+			}
+		}
+	} else {
+		TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, (quint32)chunkSize);
+		QByteArray row(Width * 3, 0);
+		for (int y = 0; y < Height; y++) {
+			for (int x = 0; x < Width; x++) {
+				for (int c = 0; c < 3; c++) row[x * 3 + c] = (char)pixelValue(x, y, c);
+			}
+			ok = ok && TIFFWriteScanline(tiff, row.data(), y, 0) >= 0;
+		}
+	}
+
+	TIFFClose(tiff);
+	return ok;
+}
+
+// Average of each block of source pixels, rounded to the nearest level
+QImage referenceRegion(const QRect& rect, int shift) {
+	QRect region = rect & QRect(0, 0, Width, Height);
+	int blockSize = 1 << shift;
+	QImage output((region.width() + blockSize - 1) >> shift, (region.height() + blockSize - 1) >> shift, QImage::Format_ARGB32_Premultiplied);
+
+	for (int outputY = 0; outputY < output.height(); outputY++) {
+		for (int outputX = 0; outputX < output.width(); outputX++) {
+			int sums[3] = { 0, 0, 0 };
+			int count = 0;
+			for (int y = region.top() + outputY * blockSize; y < qMin(region.top() + (outputY + 1) * blockSize, region.bottom() + 1); y++) {
+				for (int x = region.left() + outputX * blockSize; x < qMin(region.left() + (outputX + 1) * blockSize, region.right() + 1); x++) {
+					for (int c = 0; c < 3; c++) sums[c] += pixelValue(x, y, c);
+					count++;
+				}
+			}
+			output.setPixel(outputX, outputY, qRgb((sums[0] + count / 2) / count, (sums[1] + count / 2) / count, (sums[2] + count / 2) / count));
+		}
+	}
+
+	return output;
+}
+
+}
+
+class TestTiffReader : public QObject {
+
+	Q_OBJECT
+
+private:
+
+	QTemporaryDir dir_;
+
+private slots:
+
+	void initTestCase() {
+		QVERIFY(dir_.isValid());
+		QVERIFY(writeTiff(dir_.filePath("tiled.tif"), true, 64));
+		QVERIFY(writeTiff(dir_.filePath("strips.tif"), false, 7));
+	}
+
+	void readRegion_data() {
+		QTest::addColumn<QString>("fileName");
+		QTest::addColumn<QRect>("rect");
+		QTest::addColumn<int>("shift");
+
+		const char* fileNames[] = { "tiled.tif", "strips.tif" };
+
+		for (int i = 0; i < 2; i++) {
+			for (int shift = 0; shift < 4; shift++) {
+				QString n = QString("%1 1/%2").arg(fileNames[i]).arg(1 << shift);
+				QTest::newRow(qPrintable(n + " whole")) << fileNames[i] << QRect(0, 0, Width, Height) << shift;
+				QTest::newRow(qPrintable(n + " unaligned")) << fileNames[i] << QRect(37, 61, 300, 211) << shift;
+				QTest::newRow(qPrintable(n + " one tile")) << fileNames[i] << QRect(64, 128, 64, 64) << shift;
+				QTest::newRow(qPrintable(n + " clipped")) << fileNames[i] << QRect(900, 650, 512, 512) << shift;
+			}
+		}
+	}
+
+	void readRegion() {
+		QFETCH(QString, fileName);
+		QFETCH(QRect, rect);
+		QFETCH(int, shift);
+
+		QString error;
+		QImage output = tiffReader::readRegion(dir_.filePath(fileName), rect, shift, QSharedPointer<QAtomicInt>(), &error);
+		QVERIFY2(!output.isNull(), qPrintable(error));
+
+		QImage expected = referenceRegion(rect, shift);
+		QCOMPARE(output.size(), expected.size());
+
+		for (int y = 0; y < output.height(); y++) {
+			for (int x = 0; x < output.width(); x++) {
+				if (output.pixel(x, y) != expected.pixel(x, y)) QFAIL(qPrintable(QString("Pixel %1, %2 differs").arg(x).arg(y)));
+			}
+		}
+	}
+
+	void canReadRegions() {
+		QVERIFY(tiffReader::canReadRegions(dir_.filePath("tiled.tif")));
+		QVERIFY(tiffReader::canReadRegions(dir_.filePath("strips.tif")));
+		QVERIFY(!tiffReader::canReadRegions(dir_.filePath("missing.tif")));
+	}
+
+	void canceled() {
+		QSharedPointer<QAtomicInt> canceled(new QAtomicInt(1));
+		QVERIFY(tiffReader::readRegion(dir_.filePath("tiled.tif"), QRect(0, 0, Width, Height), 0, canceled).isNull());
+	}
+
+};
+
+QTEST_APPLESS_MAIN(TestTiffReader)
+
+#include "tst_tiffreader.moc"